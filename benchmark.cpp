@@ -0,0 +1,409 @@
+// Routing and simulation benchmark on synthetic road networks.
+//
+//   g++ -std=c++17 -O2 -pthread benchmark.cpp -o benchmark
+//   ./benchmark --network=grid --size=90000 --vehicles=100000 --queries=1000
+//
+// Generates a network (grid, random geometric or scale-free) and a vehicle set, writes the network
+// as CSV and reports CSV and binary load times, query latency percentiles and throughput for every
+// routing mode, fleet routing, tick-by-tick and event-driven simulation times, and after each phase
+// the process's peak memory so far. That is a high-water mark: a phase only raises it when it
+// needs more memory than every phase before it.
+#define ROAD_NETWORK_NO_MAIN
+#include "latest.cpp"
+#undef ROAD_NETWORK_NO_MAIN
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <random>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+enum NetworkShape {
+    GRID,      // Square grid, roads both ways between neighbours
+    GEOMETRIC, // Random points joined to the points within a radius, travel time ~ distance
+    SCALE_FREE // Preferential attachment, a few hubs with many roads
+};
+
+// Milliseconds since start
+double elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Peak resident memory of the process so far in megabytes, 0 where it cannot be read
+double peakMemoryMb() {
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return usage.ru_maxrss / (1024.0 * 1024.0); // Bytes
+#else
+        return usage.ru_maxrss / 1024.0; // Kilobytes
+#endif
+    }
+#endif
+    return 0;
+}
+
+// Id of generated intersection i
+string intersectionId(int i) {
+    return "n" + to_string(i);
+}
+
+// Writes a road both ways, each direction with its own travel time
+void writeRoadPair(ofstream& roads, int from, int to, int forward, int backward) {
+    roads << intersectionId(from) << "," << intersectionId(to) << "," << forward << "\n";
+    roads << intersectionId(to) << "," << intersectionId(from) << "," << backward << "\n";
+}
+
+// Writes a synthetic network of about size intersections to roadFile, and their positions to
+// coordinateFile for the shapes that have them. Returns the number of intersections written.
+int generateNetwork(NetworkShape shape, int size, mt19937& random, const char* roadFile,
+                    const char* coordinateFile) {
+    ofstream roads(roadFile);
+    roads << "Intersection1,Intersection2,TravelTime\n";
+    uniform_int_distribution<int> jitter(0, 50); // Percent added to the base travel time
+
+    int count = 0;
+    double* x = nullptr;
+    double* y = nullptr;
+    if (shape == GRID) {
+        int side = (int)sqrt((double)size);
+        if (side < 2) side = 2;
+        count = side * side;
+        x = new double[count];
+        y = new double[count];
+        for (int row = 0; row < side; ++row) {
+            for (int column = 0; column < side; ++column) {
+                int i = row * side + column;
+                x[i] = column * 100;
+                y[i] = row * 100;
+                if (column + 1 < side) {
+                    writeRoadPair(roads, i, i + 1, 10 + 10 * jitter(random) / 50, 10 + 10 * jitter(random) / 50);
+                }
+                if (row + 1 < side) {
+                    writeRoadPair(roads, i, i + side, 10 + 10 * jitter(random) / 50, 10 + 10 * jitter(random) / 50);
+                }
+            }
+        }
+    } else if (shape == GEOMETRIC) {
+        // Points in a square with about 8 neighbours each, found through cells one radius wide
+        count = size > 2 ? size : 2;
+        double side = sqrt((double)count) * 100;
+        double radius = sqrt(8 / 3.14159265 * side * side / count);
+        x = new double[count];
+        y = new double[count];
+        uniform_real_distribution<double> position(0, side);
+        for (int i = 0; i < count; ++i) {
+            x[i] = position(random);
+            y[i] = position(random);
+        }
+
+        int cells = (int)(side / radius) + 1;
+        int* cellStart = new int[cells * cells + 1]();
+        int* cellMembers = new int[count];
+        auto cellOf = [&](int i) { return (int)(y[i] / radius) * cells + (int)(x[i] / radius); };
+        for (int i = 0; i < count; ++i) cellStart[cellOf(i) + 1]++;
+        for (int c = 0; c < cells * cells; ++c) cellStart[c + 1] += cellStart[c];
+        int* fill = new int[cells * cells];
+        for (int c = 0; c < cells * cells; ++c) fill[c] = cellStart[c];
+        for (int i = 0; i < count; ++i) cellMembers[fill[cellOf(i)]++] = i;
+
+        for (int i = 0; i < count; ++i) {
+            int row = (int)(y[i] / radius), column = (int)(x[i] / radius);
+            for (int r = row - 1; r <= row + 1; ++r) {
+                for (int c = column - 1; c <= column + 1; ++c) {
+                    if (r < 0 || c < 0 || r >= cells || c >= cells) continue;
+                    for (int k = cellStart[r * cells + c]; k < cellStart[r * cells + c + 1]; ++k) {
+                        int j = cellMembers[k];
+                        if (j <= i) continue;
+                        double distance = sqrt((x[i] - x[j]) * (x[i] - x[j]) + (y[i] - y[j]) * (y[i] - y[j]));
+                        if (distance > radius) continue;
+                        int base = (int)(distance / 10) + 1;
+                        writeRoadPair(roads, i, j, base + base * jitter(random) / 100, base + base * jitter(random) / 100);
+                    }
+                }
+            }
+        }
+        delete[] cellStart;
+        delete[] cellMembers;
+        delete[] fill;
+    } else {
+        // Barabasi-Albert: every new intersection joins two existing ones picked in proportion to
+        // their roads, by sampling the list of road ends
+        count = size > 3 ? size : 3;
+        vector<int> ends;
+        writeRoadPair(roads, 0, 1, 10, 10);
+        writeRoadPair(roads, 1, 2, 10, 10);
+        writeRoadPair(roads, 2, 0, 10, 10);
+        ends.insert(ends.end(), { 0, 1, 1, 2, 2, 0 });
+        uniform_int_distribution<int> travelTime(5, 30);
+        for (int i = 3; i < count; ++i) {
+            int first = ends[random() % ends.size()];
+            int second = first;
+            while (second == first) second = ends[random() % ends.size()];
+            writeRoadPair(roads, i, first, travelTime(random), travelTime(random));
+            writeRoadPair(roads, i, second, travelTime(random), travelTime(random));
+            ends.insert(ends.end(), { i, first, i, second });
+        }
+    }
+    roads.close();
+
+    if (x) {
+        ofstream coordinates(coordinateFile);
+        coordinates << "Intersection,X,Y\n";
+        for (int i = 0; i < count; ++i) {
+            coordinates << intersectionId(i) << "," << x[i] << "," << y[i] << "\n";
+        }
+        coordinates.close();
+    }
+    delete[] x;
+    delete[] y;
+    return count;
+}
+
+// Value at quantile q of sorted
+double percentile(const vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0;
+    int at = (int)(q * (sorted.size() - 1) + 0.5);
+    return sorted[at];
+}
+
+// Runs the query set one at a time for latencies, then spread over the pool for throughput
+void benchmarkMode(Graph& graph, const char* name, double preparationMs, const int* starts, const int* ends,
+                   int queryCount, WorkerPool& pool) {
+    SearchBuffers buffers(graph.getIntersectionCount());
+    Route route;
+    vector<double> latencies(queryCount);
+    long long totalTime = 0;
+    for (int q = 0; q < queryCount; ++q) {
+        auto start = chrono::steady_clock::now();
+        int distance = 0;
+        graph.findRoute(starts[q], ends[q], buffers, route, &distance);
+        latencies[q] = elapsedMs(start) * 1000;
+        if (!route.empty()) totalTime += distance;
+    }
+    sort(latencies.begin(), latencies.end());
+
+    SearchBuffers** workerBuffers = new SearchBuffers*[pool.size()];
+    for (int i = 0; i < pool.size(); ++i) workerBuffers[i] = nullptr;
+    auto start = chrono::steady_clock::now();
+    pool.run(queryCount, 16, [&](int begin, int end, int worker) {
+        if (!workerBuffers[worker]) workerBuffers[worker] = new SearchBuffers(graph.getIntersectionCount());
+        Route workerRoute;
+        for (int q = begin; q < end; ++q) {
+            graph.findRoute(starts[q], ends[q], *workerBuffers[worker], workerRoute);
+        }
+    });
+    double batchMs = elapsedMs(start);
+    for (int i = 0; i < pool.size(); ++i) delete workerBuffers[i];
+    delete[] workerBuffers;
+
+    // The travel-time checksum must agree between modes
+    cout << left << setw(22) << name << right << fixed << setprecision(1) << setw(10) << preparationMs
+         << setw(10) << percentile(latencies, 0.5) << setw(10) << percentile(latencies, 0.9)
+         << setw(10) << percentile(latencies, 0.99) << setw(10) << latencies.back() << setw(12)
+         << (batchMs > 0 ? queryCount / (batchMs / 1000) : 0) << setw(16) << totalTime << setw(10)
+         << peakMemoryMb() << "\n";
+}
+
+// Ticks the fleet until every vehicle has arrived or maxTicks, returning the number of ticks
+int runTicks(FleetState& fleet, RoadCongestion* congestion, int maxTicks, WorkerPool& pool) {
+    int ticks = 0;
+    bool active = true;
+    while (active && ticks < maxTicks) {
+        active = fleet.tick(&pool, congestion);
+        ticks++;
+    }
+    return ticks;
+}
+
+void printUsage() {
+    cout << "Usage: benchmark [--network=grid|geometric|scale-free] [--size=INTERSECTIONS]\n"
+         << "                 [--vehicles=N] [--origins=N] [--queries=N] [--threads=N] [--landmarks=K]\n"
+         << "                 [--capacity=N] [--max-ticks=N] [--seed=N]"
+         << " [--skip-hierarchy] [--skip-simulation]\n";
+}
+
+int main(int argc, char* argv[]) {
+    NetworkShape shape = GRID;
+    int size = 40000;
+    int vehicleCount = 100000;
+    int queryCount = 1000;
+    int threads = 0;
+    int landmarkCount = 16;
+    int originCount = 1000; // Distinct vehicle start intersections
+    int roadCapacity = 200; // Vehicles per road before it slows down, for the congested simulation
+    int maxTicks = 100000;
+    unsigned seed = 1;
+    bool skipHierarchy = false;
+    bool skipSimulation = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--network=grid") == 0) shape = GRID;
+        else if (strcmp(argv[i], "--network=geometric") == 0) shape = GEOMETRIC;
+        else if (strcmp(argv[i], "--network=scale-free") == 0) shape = SCALE_FREE;
+        else if (strncmp(argv[i], "--size=", 7) == 0) size = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--vehicles=", 11) == 0) vehicleCount = atoi(argv[i] + 11);
+        else if (strncmp(argv[i], "--queries=", 10) == 0) queryCount = atoi(argv[i] + 10);
+        else if (strncmp(argv[i], "--threads=", 10) == 0) threads = atoi(argv[i] + 10);
+        else if (strncmp(argv[i], "--landmarks=", 12) == 0) landmarkCount = atoi(argv[i] + 12);
+        else if (strncmp(argv[i], "--origins=", 10) == 0) originCount = atoi(argv[i] + 10);
+        else if (strncmp(argv[i], "--capacity=", 11) == 0) roadCapacity = atoi(argv[i] + 11);
+        else if (strncmp(argv[i], "--max-ticks=", 12) == 0) maxTicks = atoi(argv[i] + 12);
+        else if (strncmp(argv[i], "--seed=", 7) == 0) seed = (unsigned)atoi(argv[i] + 7);
+        else if (strcmp(argv[i], "--skip-hierarchy") == 0) skipHierarchy = true;
+        else if (strcmp(argv[i], "--skip-simulation") == 0) skipSimulation = true;
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (queryCount < 1) queryCount = 1;
+    if (vehicleCount < 0) vehicleCount = 0;
+    if (maxTicks < 1) maxTicks = 1;
+
+    WorkerPool pool(threads);
+    mt19937 random(seed);
+    const char* roadFile = "benchmark_roads.csv";
+    const char* coordinateFile = "benchmark_coordinates.csv";
+    const char* binaryFile = "benchmark_roads.bin";
+    const char* shapeNames[] = { "grid", "geometric", "scale-free" };
+
+    // Network
+    auto start = chrono::steady_clock::now();
+    int intersectionCount = generateNetwork(shape, size, random, roadFile, coordinateFile);
+    double generateMs = elapsedMs(start);
+
+    // The bulk load builds the routing snapshot itself, so freeze() has nothing left to do
+    Graph graph;
+    start = chrono::steady_clock::now();
+    readCSVAndBuildGraph(roadFile, graph, &pool);
+    graph.freeze();
+    double loadMs = elapsedMs(start);
+    bool coordinates = shape != SCALE_FREE && graph.loadCoordinates(coordinateFile);
+
+    // Binary copy: written from the loaded graph, then mapped into a fresh one
+    start = chrono::steady_clock::now();
+    bool saved = graph.saveBinary(binaryFile, roadFile);
+    double saveMs = elapsedMs(start);
+    double binaryLoadMs = 0;
+    bool loaded = false;
+    if (saved) {
+        Graph copy;
+        start = chrono::steady_clock::now();
+        loaded = copy.loadBinary(binaryFile, roadFile);
+        binaryLoadMs = elapsedMs(start);
+    }
+
+    cout << fixed << setprecision(1);
+    cout << "Network: " << shapeNames[shape] << ", " << graph.getIntersectionCount() << " intersections, "
+         << graph.getRoadCount() << " roads, " << pool.size() << " threads\n";
+    cout << "Generate " << generateMs << " ms, readCSVAndBuildGraph " << loadMs << " ms, peak memory "
+         << peakMemoryMb() << " MB\n";
+    if (loaded) {
+        cout << "saveBinary " << saveMs << " ms, loadBinary " << binaryLoadMs << " ms\n";
+    } else {
+        cout << "Binary network could not be " << (saved ? "loaded" : "written") << "\n";
+    }
+
+    // Queries between uniformly random intersections; every mode answers the same set
+    uniform_int_distribution<int> pick(0, intersectionCount - 1);
+    int* starts = new int[queryCount];
+    int* ends = new int[queryCount];
+    for (int q = 0; q < queryCount; ++q) {
+        starts[q] = graph.getIndex(intersectionId(pick(random)));
+        ends[q] = graph.getIndex(intersectionId(pick(random)));
+    }
+
+    cout << "\n" << left << setw(22) << "Mode" << right << setw(10) << "Prep ms" << setw(10) << "p50 us"
+         << setw(10) << "p90 us" << setw(10) << "p99 us" << setw(10) << "max us" << setw(12) << "queries/s"
+         << setw(16) << "time checksum" << setw(10) << "peak MB" << "\n";
+    // peak MB is the process high-water mark after the mode, not what the mode alone used
+
+    graph.setRoutingMode(BINARY_HEAP);
+    benchmarkMode(graph, "binary-heap", 0, starts, ends, queryCount, pool);
+    graph.setRoutingMode(RADIX_HEAP);
+    benchmarkMode(graph, "radix-heap", 0, starts, ends, queryCount, pool);
+    graph.setRoutingMode(BIDIRECTIONAL);
+    benchmarkMode(graph, "bidirectional", 0, starts, ends, queryCount, pool);
+    if (coordinates) {
+        graph.setRoutingMode(ASTAR);
+        benchmarkMode(graph, "astar", 0, starts, ends, queryCount, pool);
+    }
+    if (landmarkCount > 0) {
+        start = chrono::steady_clock::now();
+        graph.selectLandmarks(landmarkCount, pool);
+        double preparationMs = elapsedMs(start);
+        graph.setRoutingMode(ALT);
+        benchmarkMode(graph, "alt", preparationMs, starts, ends, queryCount, pool);
+    }
+    if (!skipHierarchy) {
+        start = chrono::steady_clock::now();
+        graph.buildContractionHierarchy();
+        double preparationMs = elapsedMs(start);
+        graph.setRoutingMode(CONTRACTION_HIERARCHY);
+        benchmarkMode(graph, "contraction-hierarchy", preparationMs, starts, ends, queryCount, pool);
+    }
+    delete[] starts;
+    delete[] ends;
+
+    // Fleet routing and simulation with the fastest mode that needs no preparation
+    graph.setRoutingMode(BINARY_HEAP);
+    if (vehicleCount > 0) {
+        // Vehicles leave from a limited set of depots, spread over the intersection numbers
+        if (originCount > intersectionCount) originCount = intersectionCount;
+        if (originCount < 1) originCount = 1;
+        uniform_int_distribution<int> pickOrigin(0, originCount - 1);
+        int originStride = intersectionCount / originCount;
+        Vehicle* vehicles = new Vehicle[vehicleCount];
+        for (int i = 0; i < vehicleCount; ++i) {
+            string id = "V" + to_string(i);
+            vehicles[i] = Vehicle(id.c_str(), intersectionId(pickOrigin(random) * originStride),
+                                  intersectionId(pick(random)));
+        }
+
+        // The routing functions report unreachable destinations on cout
+        streambuf* output = cout.rdbuf(nullptr);
+        start = chrono::steady_clock::now();
+        Route* routes = findShortestPathsByOrigin(graph, vehicles, vehicleCount, pool);
+        double routingMs = elapsedMs(start);
+        cout.rdbuf(output);
+        cout.clear();
+        cout << "\nfindShortestPathsByOrigin: " << vehicleCount << " vehicles in " << routingMs << " ms ("
+             << vehicleCount / (routingMs / 1000) << " vehicles/s), peak memory " << peakMemoryMb() << " MB\n";
+
+        if (!skipSimulation) {
+            for (int congested = 0; congested < 2; ++congested) {
+                FleetState fleet(graph, routes, vehicleCount);
+                RoadCongestion* congestion =
+                    congested ? new RoadCongestion(graph, roadCapacity, pool.size()) : nullptr;
+                start = chrono::steady_clock::now();
+                int ticks = runTicks(fleet, congestion, maxTicks, pool);
+                double simulationMs = elapsedMs(start);
+                cout << (congested ? "Simulation with congestion: " : "Simulation: ") << ticks
+                     << (ticks == maxTicks ? " ticks (stopped) in " : " ticks in ")
+                     << simulationMs << " ms (" << setprecision(3) << simulationMs / ticks << setprecision(1)
+                     << " ms per tick), peak memory " << peakMemoryMb() << " MB\n";
+                delete congestion;
+            }
+
+            // The event-driven simulation prints its status reports, which are discarded here
+            output = cout.rdbuf(nullptr);
+            start = chrono::steady_clock::now();
+            eventDrivenMovement(vehicles, vehicleCount, routes, graph, 0);
+            double eventMs = elapsedMs(start);
+            cout.rdbuf(output);
+            cout.clear();
+            cout << "Event-driven simulation: " << eventMs << " ms, peak memory " << peakMemoryMb() << " MB\n";
+        }
+
+        delete[] routes;
+        delete[] vehicles;
+    }
+
+    remove(roadFile);
+    remove(coordinateFile);
+    remove(binaryFile);
+    return 0;
+}
@@ -0,0 +1,62 @@
+// Checks that paths and roads print so that their intersection ids can be read back.
+//
+//   g++ -std=c++17 -pthread format_test.cpp -o format_test && ./format_test
+//
+// Exits with 1 and names the failing check when a printed line differs from the expected one.
+#define ROAD_NETWORK_NO_MAIN
+#include "latest.cpp"
+#undef ROAD_NETWORK_NO_MAIN
+
+int failures = 0;
+
+void expect(const string& what, const string& actual, const string& expected) {
+    if (actual != expected) {
+        cout << "FAIL " << what << ": got \"" << actual << "\", expected \"" << expected << "\"\n";
+        failures++;
+    }
+}
+
+// Status line of a vehicle on the first road of route
+string status(const Graph& graph, const Route& route) {
+    ostringstream out;
+    printVehicleStatus(out, Vehicle("V1", graph.getId(route.front()), graph.getId(route.back())), graph, route,
+                       false, 1, 3);
+    return out.str();
+}
+
+int main() {
+    // Single-character ids keep the original back-to-back form
+    Graph letters;
+    letters.addRoad("A", "B", 1);
+    letters.addRoad("B", "C", 1);
+    expect("single-character path", letters.findShortestPath("A", "C"), "ABC");
+    Route abc;
+    abc.push_back(letters.getIndex("A"));
+    abc.push_back(letters.getIndex("B"));
+    abc.push_back(letters.getIndex("C"));
+    expect("single-character road", status(letters, abc), "V1 is on road AB (remaining time: 3 seconds)\n");
+
+    // "1" "12" "3" would read as "1123", which could also be "11" "2" "3"
+    Graph numbers;
+    numbers.addRoad("1", "12", 1);
+    numbers.addRoad("12", "3", 1);
+    numbers.addRoad("11", "2", 5);
+    numbers.addRoad("2", "3", 5);
+    expect("multi-character path", numbers.findShortestPath("1", "3"), "1->12->3");
+    expect("other multi-character path", numbers.findShortestPath("11", "3"), "11->2->3");
+    Route route;
+    route.push_back(numbers.getIndex("1"));
+    route.push_back(numbers.getIndex("12"));
+    route.push_back(numbers.getIndex("3"));
+    expect("multi-character road", status(numbers, route), "V1 is on road 1->12 (remaining time: 3 seconds)\n");
+
+    // One long id is enough to separate every id of the graph
+    Graph mixed;
+    mixed.addRoad("A", "B", 1);
+    mixed.addRoad("B", "Depot", 1);
+    expect("mixed path", mixed.findShortestPath("A", "Depot"), "A->B->Depot");
+
+    if (failures > 0) return 1;
+    cout << "All format checks passed.\n";
+    return 0;
+}
@@ -1,329 +1,4032 @@
 #include <iostream>
 #include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
-class Graph {
-    struct Road {
-        char intersection;
+// Intersection indices along a path, start first; empty when there is no path
+typedef vector<int> Route;
+
+// Travel time to an intersection that cannot be reached, and of a closed road. Used in place of
+// INT_MAX so that adding a road's time to it cannot overflow.
+const int UNREACHABLE = 99999999;
+
+// Which priority queue drives Dijkstra's search
+enum RoutingMode {
+    BINARY_HEAP, // Indexed binary heap with decrease-key
+    RADIX_HEAP,   // Monotone radix heap, travel times are non-negative integers
+    BIDIRECTIONAL, // Binary heaps searching from both ends until they meet
+    ASTAR,         // Binary heap keyed by travel time plus a straight-line bound, needs coordinates
+    CONTRACTION_HIERARCHY, // Upward searches in a prebuilt hierarchy, see buildContractionHierarchy
+    ALT                    // A* bounded by landmark travel times, see selectLandmarks
+};
+
+// Instrumentation, compiled in with -DROAD_NETWORK_PROFILE and free otherwise. PROFILE_COUNT adds
+// to a per-thread counter; PROFILE_SCOPE times the rest of the enclosing block as a named span,
+// noting how many intersections it settled and roads it relaxed. main writes the totals as JSON
+// (--profile=FILE) or the spans as a Chrome trace (--trace=FILE, for chrome://tracing) at exit.
+#ifdef ROAD_NETWORK_PROFILE
+enum ProfileCounter {
+    SETTLED_NODES,
+    RELAXED_EDGES,
+    HEAP_PUSHES,
+    HEAP_POPS,
+    FIND_INDEX_CALLS,
+    PROFILE_COUNTER_COUNT
+};
+
+const char* const profileCounterNames[PROFILE_COUNTER_COUNT] = {
+    "settled_nodes", "relaxed_edges", "heap_pushes", "heap_pops", "find_index_calls"
+};
+
+// Counters and spans of one thread, kept until exit so they can be written after the thread ends
+struct ProfileThread {
+    struct Span {
+        const char* name;
+        long long start;    // Microseconds since the profile started
+        long long duration;
+        long long settled;
+        long long relaxed;
+    };
+
+    struct Timer {
+        const char* name;
+        long long count;
+        long long total; // Microseconds
+        long long longest;
+    };
+
+    long long counters[PROFILE_COUNTER_COUNT];
+    vector<Span> spans;  // Up to spanLimit, later ones only reach the timers
+    vector<Timer> timers;
+    long long droppedSpans;
+    int id;
+
+    static const size_t spanLimit = 1 << 20;
+};
+
+class Profile {
+    mutex lock;
+    vector<ProfileThread*> threads;
+    chrono::steady_clock::time_point epoch;
+
+public:
+    Profile() : epoch(chrono::steady_clock::now()) {}
+
+    // Never destroyed, so threads and exit handlers can use it until the very end
+    static Profile& instance() {
+        static Profile* profile = new Profile;
+        return *profile;
+    }
+
+    ProfileThread* registerThread() {
+        ProfileThread* thread = new ProfileThread;
+        for (int c = 0; c < PROFILE_COUNTER_COUNT; ++c) thread->counters[c] = 0;
+        thread->droppedSpans = 0;
+        lock_guard<mutex> guard(lock);
+        thread->id = (int)threads.size();
+        threads.push_back(thread);
+        return thread;
+    }
+
+    long long now() const {
+        return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - epoch).count();
+    }
+
+    // Totals of every counter and timer over all threads
+    bool writeJson(const char* filename) {
+        ofstream file(filename);
+        if (!file.is_open()) return false;
+        lock_guard<mutex> guard(lock);
+
+        file << "{\n  \"counters\": {";
+        for (int c = 0; c < PROFILE_COUNTER_COUNT; ++c) {
+            long long total = 0;
+            for (size_t t = 0; t < threads.size(); ++t) total += threads[t]->counters[c];
+            file << (c ? ", " : "") << "\"" << profileCounterNames[c] << "\": " << total;
+        }
+
+        vector<ProfileThread::Timer> timers;
+        long long dropped = 0;
+        for (size_t t = 0; t < threads.size(); ++t) {
+            dropped += threads[t]->droppedSpans;
+            for (size_t k = 0; k < threads[t]->timers.size(); ++k) {
+                const ProfileThread::Timer& timer = threads[t]->timers[k];
+                size_t j = 0;
+                while (j < timers.size() && strcmp(timers[j].name, timer.name) != 0) ++j;
+                if (j == timers.size()) {
+                    timers.push_back(timer);
+                } else {
+                    timers[j].count += timer.count;
+                    timers[j].total += timer.total;
+                    if (timer.longest > timers[j].longest) timers[j].longest = timer.longest;
+                }
+            }
+        }
+        file << "},\n  \"timers\": {";
+        for (size_t j = 0; j < timers.size(); ++j) {
+            file << (j ? "," : "") << "\n    \"" << timers[j].name << "\": {\"count\": " << timers[j].count
+                 << ", \"total_ms\": " << timers[j].total / 1000.0 << ", \"max_ms\": " << timers[j].longest / 1000.0
+                 << "}";
+        }
+        file << "\n  },\n  \"threads\": " << threads.size() << ",\n  \"dropped_spans\": " << dropped << "\n}\n";
+        return true;
+    }
+
+    // Every recorded span as a complete event, and the counter totals at the end
+    bool writeTrace(const char* filename) {
+        ofstream file(filename);
+        if (!file.is_open()) return false;
+        lock_guard<mutex> guard(lock);
+
+        file << "{\"traceEvents\": [\n";
+        long long end = 0;
+        for (size_t t = 0; t < threads.size(); ++t) {
+            const ProfileThread& thread = *threads[t];
+            file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread.id
+                 << ", \"args\": {\"name\": \"thread " << thread.id << "\"}},\n";
+            for (size_t k = 0; k < thread.spans.size(); ++k) {
+                const ProfileThread::Span& span = thread.spans[k];
+                file << "{\"name\": \"" << span.name << "\", \"ph\": \"X\", \"ts\": " << span.start
+                     << ", \"dur\": " << span.duration << ", \"pid\": 1, \"tid\": " << thread.id
+                     << ", \"args\": {\"settled_nodes\": " << span.settled << ", \"relaxed_edges\": " << span.relaxed
+                     << "}},\n";
+                if (span.start + span.duration > end) end = span.start + span.duration;
+            }
+        }
+        file << "{\"name\": \"counters\", \"ph\": \"C\", \"ts\": " << end << ", \"pid\": 1, \"args\": {";
+        for (int c = 0; c < PROFILE_COUNTER_COUNT; ++c) {
+            long long total = 0;
+            for (size_t t = 0; t < threads.size(); ++t) total += threads[t]->counters[c];
+            file << (c ? ", " : "") << "\"" << profileCounterNames[c] << "\": " << total;
+        }
+        file << "}}\n]}\n";
+        return true;
+    }
+};
+
+// Constant-initialised, so the hot path is a plain thread-local load rather than a call
+thread_local ProfileThread* currentProfileThread = nullptr;
+
+inline ProfileThread& profileThread() {
+    if (!currentProfileThread) currentProfileThread = Profile::instance().registerThread();
+    return *currentProfileThread;
+}
+
+// Records the time from construction to the end of the enclosing block
+class ProfileScope {
+    const char* name;
+    long long start;
+    long long settled;
+    long long relaxed;
+
+public:
+    ProfileScope(const char* name) : name(name) {
+        ProfileThread& thread = profileThread();
+        settled = thread.counters[SETTLED_NODES];
+        relaxed = thread.counters[RELAXED_EDGES];
+        start = Profile::instance().now();
+    }
+
+    ~ProfileScope() {
+        long long duration = Profile::instance().now() - start;
+        ProfileThread& thread = profileThread();
+        size_t k = 0;
+        while (k < thread.timers.size() && thread.timers[k].name != name) ++k;
+        if (k == thread.timers.size()) {
+            ProfileThread::Timer timer = { name, 0, 0, 0 };
+            thread.timers.push_back(timer);
+        }
+        ProfileThread::Timer& timer = thread.timers[k];
+        timer.count++;
+        timer.total += duration;
+        if (duration > timer.longest) timer.longest = duration;
+
+        if (thread.spans.size() < ProfileThread::spanLimit) {
+            ProfileThread::Span span = { name, start, duration, thread.counters[SETTLED_NODES] - settled,
+                                         thread.counters[RELAXED_EDGES] - relaxed };
+            thread.spans.push_back(span);
+        } else {
+            thread.droppedSpans++;
+        }
+    }
+};
+
+#define PROFILE_COUNT(counter, amount) (profileThread().counters[counter] += (amount))
+#define PROFILE_SCOPE(name) ProfileScope profileScope(name)
+#else
+#define PROFILE_COUNT(counter, amount) ((void)0)
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
+
+// Binary min-heap over intersection indices that supports decrease-key
+class MinHeap {
+    int* nodes;     // Heap-ordered intersection indices
+    int* keys;      // Current key of each intersection
+    int* positions; // Slot of each intersection in nodes, -1 if not queued
+    int size;
+    int capacity;
+
+    void swapSlots(int a, int b) {
+        int temp = nodes[a];
+        nodes[a] = nodes[b];
+        nodes[b] = temp;
+        positions[nodes[a]] = a;
+        positions[nodes[b]] = b;
+    }
+
+    void siftUp(int slot) {
+        while (slot > 0) {
+            int parent = (slot - 1) / 2;
+            if (keys[nodes[parent]] <= keys[nodes[slot]]) break;
+            swapSlots(slot, parent);
+            slot = parent;
+        }
+    }
+
+    void siftDown(int slot) {
+        while (true) {
+            int smallest = slot;
+            int left = 2 * slot + 1;
+            int right = left + 1;
+            if (left < size && keys[nodes[left]] < keys[nodes[smallest]]) smallest = left;
+            if (right < size && keys[nodes[right]] < keys[nodes[smallest]]) smallest = right;
+            if (smallest == slot) break;
+            swapSlots(slot, smallest);
+            slot = smallest;
+        }
+    }
+
+public:
+    MinHeap(int capacity) : size(0), capacity(capacity) {
+        nodes = new int[capacity];
+        keys = new int[capacity];
+        positions = new int[capacity];
+        for (int i = 0; i < capacity; ++i) positions[i] = -1;
+    }
+
+    ~MinHeap() {
+        delete[] nodes;
+        delete[] keys;
+        delete[] positions;
+    }
+
+    bool empty() const { return size == 0; }
+
+    // Drops whatever an early-terminated search left queued
+    void clear() {
+        for (int i = 0; i < size; ++i) positions[nodes[i]] = -1;
+        size = 0;
+    }
+
+    // Inserts node, or lowers its key if it is already queued
+    void push(int node, int key) {
+        PROFILE_COUNT(HEAP_PUSHES, 1);
+        if (positions[node] == -1) {
+            nodes[size] = node;
+            positions[node] = size;
+            keys[node] = key;
+            siftUp(size++);
+        } else if (key < keys[node]) {
+            keys[node] = key;
+            siftUp(positions[node]);
+        }
+    }
+
+    int top() const { return nodes[0]; }
+    int topKey() const { return keys[nodes[0]]; }
+
+    int pop() {
+        PROFILE_COUNT(HEAP_POPS, 1);
+        int top = nodes[0];
+        swapSlots(0, --size);
+        positions[top] = -1;
+        if (size > 0) siftDown(0);
+        return top;
+    }
+};
+
+// Monotone radix heap: popped keys never decrease, so entries are bucketed by the
+// highest bit in which they differ from the last popped key. Stale entries are
+// left in place and skipped by the caller.
+class RadixHeap {
+    struct Entry {
+        int key;
+        int node;
+    };
+
+    struct Bucket {
+        Entry* entries;
+        int count;
+        int capacity;
+    };
+
+    Bucket buckets[33];
+    unsigned last;
+    int size;
+
+    // Position of the highest bit in which key differs from last, 0 when they are equal
+    static int bucketFor(unsigned key, unsigned last) {
+        if (key == last) return 0;
+#if defined(_MSC_VER)
+        unsigned long highest;
+        _BitScanReverse(&highest, key ^ last);
+        return (int)highest + 1;
+#else
+        return 32 - __builtin_clz(key ^ last);
+#endif
+    }
+
+    void append(Bucket& bucket, int key, int node) {
+        if (bucket.count == bucket.capacity) {
+            bucket.capacity = (bucket.capacity == 0) ? 4 : bucket.capacity * 2;
+            Entry* grown = new Entry[bucket.capacity];
+            for (int i = 0; i < bucket.count; ++i) {
+                grown[i] = bucket.entries[i];
+            }
+            delete[] bucket.entries;
+            bucket.entries = grown;
+        }
+        bucket.entries[bucket.count].key = key;
+        bucket.entries[bucket.count].node = node;
+        bucket.count++;
+    }
+
+public:
+    RadixHeap() : last(0), size(0) {
+        for (int i = 0; i < 33; ++i) {
+            buckets[i].entries = nullptr;
+            buckets[i].count = 0;
+            buckets[i].capacity = 0;
+        }
+    }
+
+    ~RadixHeap() {
+        for (int i = 0; i < 33; ++i) {
+            delete[] buckets[i].entries;
+        }
+    }
+
+    bool empty() const { return size == 0; }
+
+    void clear() {
+        for (int i = 0; i < 33; ++i) buckets[i].count = 0;
+        last = 0;
+        size = 0;
+    }
+
+    void push(int node, int key) {
+        PROFILE_COUNT(HEAP_PUSHES, 1);
+        append(buckets[bucketFor(key, last)], key, node);
+        size++;
+    }
+
+    // Removes an entry with the smallest key; returns its node and key
+    int pop(int& key) {
+        PROFILE_COUNT(HEAP_POPS, 1);
+        if (buckets[0].count == 0) {
+            int i = 1;
+            while (buckets[i].count == 0) ++i;
+
+            Bucket& source = buckets[i];
+            unsigned newLast = source.entries[0].key;
+            for (int j = 1; j < source.count; ++j) {
+                if ((unsigned)source.entries[j].key < newLast) newLast = source.entries[j].key;
+            }
+            last = newLast;
+
+            int moved = source.count;
+            source.count = 0;
+            for (int j = 0; j < moved; ++j) {
+                append(buckets[bucketFor(source.entries[j].key, last)], source.entries[j].key, source.entries[j].node);
+            }
+        }
+
+        Bucket& lowest = buckets[0];
+        lowest.count--;
+        size--;
+        key = lowest.entries[lowest.count].key;
+        return lowest.entries[lowest.count].node;
+    }
+};
+
+// Reusable workspace of one search at a time. A point-to-point search starts in O(1): each half
+// bumps its generation and an entry only counts once touch() has stamped it with the current one,
+// so entries the search never reaches are neither reset nor valid. Full-tree searches reset
+// everything with resetAll() and leave plain arrays behind.
+struct SearchBuffers {
+    int size;
+    int* distances;
+    int* predecessors;
+    bool* visited;
+    unsigned* stamps;   // Generation that last initialised each forward entry
+    unsigned generation;
+    MinHeap heap;
+    RadixHeap radix;
+
+    // Backward half of a bidirectional search: distances to the destination and the next
+    // intersection towards it
+    int* backwardDistances;
+    int* successors;
+    bool* backwardVisited;
+    unsigned* backwardStamps;
+    unsigned backwardGeneration;
+    MinHeap backwardHeap;
+    int meeting; // Where the two halves joined, -1 after a one-directional search
+    bool hierarchical; // Predecessors and successors hold contraction hierarchy edges
+
+    SearchBuffers(int size)
+        : size(size), generation(0), heap(size), backwardGeneration(0), backwardHeap(size), meeting(-1),
+          hierarchical(false) {
+        distances = new int[size];
+        predecessors = new int[size];
+        visited = new bool[size];
+        stamps = new unsigned[size]();
+        backwardDistances = new int[size];
+        successors = new int[size];
+        backwardVisited = new bool[size];
+        backwardStamps = new unsigned[size]();
+    }
+
+    ~SearchBuffers() {
+        delete[] distances;
+        delete[] predecessors;
+        delete[] visited;
+        delete[] stamps;
+        delete[] backwardDistances;
+        delete[] successors;
+        delete[] backwardVisited;
+        delete[] backwardStamps;
+    }
+
+    // Forgets the forward entries of the last search
+    void reset() {
+        if (++generation == 0) {
+            // Wrapped after 2^32 searches: stale stamps could match again
+            for (int i = 0; i < size; ++i) stamps[i] = 0;
+            generation = 1;
+        }
+    }
+
+    void resetBackward() {
+        if (++backwardGeneration == 0) {
+            for (int i = 0; i < size; ++i) backwardStamps[i] = 0;
+            backwardGeneration = 1;
+        }
+    }
+
+    // reset() for a search that will reach everything anyway: every entry is initialised now
+    void resetAll() {
+        reset();
+        for (int i = 0; i < size; ++i) {
+            distances[i] = UNREACHABLE;
+            predecessors[i] = -1;
+            visited[i] = false;
+            stamps[i] = generation;
+        }
+    }
+
+    // Makes the forward entries of v current, unreached if this search had not touched it yet
+    void touch(int v) {
+        if (stamps[v] != generation) {
+            stamps[v] = generation;
+            distances[v] = UNREACHABLE;
+            predecessors[v] = -1;
+            visited[v] = false;
+        }
+    }
+
+    void touchBackward(int v) {
+        if (backwardStamps[v] != backwardGeneration) {
+            backwardStamps[v] = backwardGeneration;
+            backwardDistances[v] = UNREACHABLE;
+            successors[v] = -1;
+            backwardVisited[v] = false;
+        }
+    }
+
+    // Distances as the last search left them, for entries it may not have touched
+    int distance(int v) const {
+        return stamps[v] == generation ? distances[v] : UNREACHABLE;
+    }
+
+    int backwardDistance(int v) const {
+        return backwardStamps[v] == backwardGeneration ? backwardDistances[v] : UNREACHABLE;
+    }
+};
+
+// Fixed set of worker threads that split a range of items into chunks and
+// pull them off a shared counter until the range is exhausted
+class WorkerPool {
+    thread* workers;
+    int workerCount;
+
+    mutex lock;
+    condition_variable wake;
+    condition_variable done;
+    function<void(int, int, int)> task;
+    int itemCount;
+    int chunkSize;
+    atomic<int> nextItem;
+    int busy;
+    long generation;
+    bool stopping;
+
+    void workerLoop(int worker) {
+        long seen = 0;
+        while (true) {
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+
+            while (true) {
+                int begin = nextItem.fetch_add(chunkSize);
+                if (begin >= itemCount) break;
+                int end = (begin + chunkSize < itemCount) ? begin + chunkSize : itemCount;
+                task(begin, end, worker);
+            }
+
+            lock_guard<mutex> guard(lock);
+            if (--busy == 0) done.notify_all();
+        }
+    }
+
+public:
+    WorkerPool(int threads = 0)
+        : itemCount(0), chunkSize(1), nextItem(0), busy(0), generation(0), stopping(false) {
+        if (threads <= 0) threads = thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+        workerCount = threads;
+        workers = new thread[workerCount];
+        for (int i = 0; i < workerCount; ++i) {
+            workers[i] = thread(&WorkerPool::workerLoop, this, i);
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (int i = 0; i < workerCount; ++i) {
+            workers[i].join();
+        }
+        delete[] workers;
+    }
+
+    int size() const { return workerCount; }
+
+    // Calls work(begin, end, worker) over [0, count) in chunks and waits for all of them
+    void run(int count, int chunk, const function<void(int, int, int)>& work) {
+        if (count <= 0) return;
+        unique_lock<mutex> guard(lock);
+        task = work;
+        itemCount = count;
+        chunkSize = (chunk > 0) ? chunk : 1;
+        nextItem = 0;
+        busy = workerCount;
+        generation++;
+        wake.notify_all();
+        done.wait(guard, [&] { return busy == 0; });
+    }
+};
+
+// Bounded least-recently-used cache of routes keyed by (start, end) intersection index.
+// Routes are kept as index sequences; a distance of UNREACHABLE records "no path".
+class PathCache {
+    struct Entry {
+        int start;
+        int end;
+        int distance;
+        int* route;
         int length;
-        Road* next;
+        int newer; // Neighbours in the recency list, -1 at either end
+        int older;
+        int chain; // Next entry in the same hash bucket
+    };
+
+    Entry* entries;
+    int capacity;
+    int used;
+    int* buckets;
+    int bucketMask;
+    int newest;
+    int oldest;
+    int freeEntries; // Entries dropped by invalidateRoad, chained through chain
+    long hitCount;
+    long missCount;
+    mutex lock;
+
+    int bucketFor(int start, int end) const {
+        return (int)(((unsigned)start * 2654435761u) ^ (unsigned)end) & bucketMask;
+    }
+
+    int find(int start, int end) const {
+        for (int e = buckets[bucketFor(start, end)]; e != -1; e = entries[e].chain) {
+            if (entries[e].start == start && entries[e].end == end) return e;
+        }
+        return -1;
+    }
+
+    void unlinkRecency(int e) {
+        if (entries[e].newer != -1) entries[entries[e].newer].older = entries[e].older;
+        else newest = entries[e].older;
+        if (entries[e].older != -1) entries[entries[e].older].newer = entries[e].newer;
+        else oldest = entries[e].newer;
+    }
+
+    void pushNewest(int e) {
+        entries[e].newer = -1;
+        entries[e].older = newest;
+        if (newest != -1) entries[newest].newer = e;
+        newest = e;
+        if (oldest == -1) oldest = e;
+    }
+
+    void unlinkChain(int e) {
+        int* link = &buckets[bucketFor(entries[e].start, entries[e].end)];
+        while (*link != e) link = &entries[*link].chain;
+        *link = entries[e].chain;
+    }
+
+public:
+    PathCache(int capacity)
+        : capacity(capacity), used(0), newest(-1), oldest(-1), freeEntries(-1), hitCount(0), missCount(0) {
+        entries = new Entry[capacity];
+        for (int i = 0; i < capacity; ++i) entries[i].route = nullptr;
+        int bucketCount = 1;
+        while (bucketCount < 2 * capacity) bucketCount *= 2;
+        bucketMask = bucketCount - 1;
+        buckets = new int[bucketCount];
+        for (int i = 0; i < bucketCount; ++i) buckets[i] = -1;
+    }
+
+    ~PathCache() {
+        for (int i = 0; i < capacity; ++i) delete[] entries[i].route;
+        delete[] entries;
+        delete[] buckets;
+    }
+
+    // Copies a cached route out and marks it recently used
+    bool lookup(int start, int end, Route& route, int& distance) {
+        lock_guard<mutex> guard(lock);
+        int e = find(start, end);
+        if (e == -1) {
+            missCount++;
+            return false;
+        }
+        hitCount++;
+        unlinkRecency(e);
+        pushNewest(e);
+        distance = entries[e].distance;
+        route.assign(entries[e].route, entries[e].route + entries[e].length);
+        return true;
+    }
+
+    void store(int start, int end, const Route& route, int distance) {
+        lock_guard<mutex> guard(lock);
+        int e = find(start, end);
+        if (e != -1) {
+            unlinkRecency(e);
+            unlinkChain(e);
+        } else if (freeEntries != -1) {
+            e = freeEntries;
+            freeEntries = entries[e].chain;
+        } else if (used < capacity) {
+            e = used++;
+        } else {
+            e = oldest;
+            unlinkRecency(e);
+            unlinkChain(e);
+        }
+
+        int length = (int)route.size();
+        delete[] entries[e].route;
+        entries[e].route = new int[length > 0 ? length : 1];
+        for (int i = 0; i < length; ++i) entries[e].route[i] = route[i];
+        entries[e].length = length;
+        entries[e].distance = distance;
+        entries[e].start = start;
+        entries[e].end = end;
+
+        int bucket = bucketFor(start, end);
+        entries[e].chain = buckets[bucket];
+        buckets[bucket] = e;
+        pushNewest(e);
+    }
+
+    void clear() {
+        lock_guard<mutex> guard(lock);
+        for (int i = 0; i <= bucketMask; ++i) buckets[i] = -1;
+        used = 0;
+        newest = oldest = freeEntries = -1;
+    }
+
+    // Drops the cached routes that drive along the road from -> to
+    void invalidateRoad(int from, int to) {
+        lock_guard<mutex> guard(lock);
+        int e = newest;
+        while (e != -1) {
+            int older = entries[e].older;
+            const int* route = entries[e].route;
+            for (int i = 0; i + 1 < entries[e].length; ++i) {
+                if (route[i] == from && route[i + 1] == to) {
+                    unlinkRecency(e);
+                    unlinkChain(e);
+                    entries[e].chain = freeEntries;
+                    freeEntries = e;
+                    break;
+                }
+            }
+            e = older;
+        }
+    }
+
+    long hits() const { return hitCount; }
+    long misses() const { return missCount; }
+};
+
+// View of a whole file, memory-mapped where the platform supports it. A copy-on-write view
+// can be modified in memory without touching the file.
+class MappedFile {
+    const char* bytes;
+    size_t length;
+    bool mapped;
+
+public:
+    MappedFile() : bytes(nullptr), length(0), mapped(false) {}
+    ~MappedFile() { close(); }
+
+    bool open(const char* filename, bool copyOnWrite = false) {
+        close();
+#ifndef _WIN32
+        int descriptor = ::open(filename, O_RDONLY);
+        if (descriptor == -1) return false;
+        struct stat info;
+        if (fstat(descriptor, &info) == -1) {
+            ::close(descriptor);
+            return false;
+        }
+        length = (size_t)info.st_size;
+        if (length > 0) {
+            int protection = copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+            void* view = mmap(nullptr, length, protection, MAP_PRIVATE, descriptor, 0);
+            if (view != MAP_FAILED) {
+                madvise(view, length, MADV_SEQUENTIAL);
+                bytes = (const char*)view;
+                mapped = true;
+            }
+        }
+        ::close(descriptor);
+        if (length == 0 || mapped) return true;
+#endif
+        // No mapping available: read the file into memory instead
+        ifstream file(filename, ios::binary);
+        if (!file.is_open()) return false;
+        file.seekg(0, ios::end);
+        length = (size_t)file.tellg();
+        file.seekg(0, ios::beg);
+        char* buffer = new char[length > 0 ? length : 1];
+        file.read(buffer, length);
+        bytes = buffer;
+        return true;
+    }
+
+    void close() {
+#ifndef _WIN32
+        if (mapped) munmap((void*)bytes, length);
+#endif
+        if (!mapped) delete[] bytes;
+        bytes = nullptr;
+        length = 0;
+        mapped = false;
+    }
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+};
+
+// Bump allocator that hands out objects from large contiguous slabs. Objects are never freed
+// one by one; release() drops every slab at once.
+template <typename T>
+class SlabArena {
+    T** slabs;
+    int slabCount;
+    int slabCapacity;
+    int used;     // Objects handed out from the newest slab
+    int slabSize; // Size of the newest slab
+
+    void addSlab(int size) {
+        if (slabCount == slabCapacity) {
+            slabCapacity = (slabCapacity == 0) ? 8 : slabCapacity * 2;
+            T** grown = new T*[slabCapacity];
+            for (int i = 0; i < slabCount; ++i) {
+                grown[i] = slabs[i];
+            }
+            delete[] slabs;
+            slabs = grown;
+        }
+        slabs[slabCount++] = new T[size];
+        slabSize = size;
+        used = 0;
+    }
+
+public:
+    SlabArena() : slabs(nullptr), slabCount(0), slabCapacity(0), used(0), slabSize(0) {}
+    ~SlabArena() { release(); }
+
+    T* allocate() {
+        if (used == slabSize) {
+            int size = (slabSize == 0) ? 256 : slabSize * 2;
+            addSlab(size < 65536 ? size : 65536);
+        }
+        return &slabs[slabCount - 1][used++];
+    }
+
+    // Makes sure the next count allocations come from one contiguous slab
+    void reserve(int count) {
+        if (slabSize - used < count) addSlab(count);
+    }
+
+    void release() {
+        for (int i = 0; i < slabCount; ++i) {
+            delete[] slabs[i];
+        }
+        delete[] slabs;
+        slabs = nullptr;
+        slabCount = slabCapacity = used = slabSize = 0;
+    }
+};
+
+// FNV-1a hash of an intersection id
+unsigned hashId(const char* id, int length) {
+    unsigned hash = 2166136261u;
+    for (int i = 0; i < length; ++i) {
+        hash = (hash ^ (unsigned char)id[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Splits one CSV line into at most maxFields comma-separated fields with surrounding blanks
+// (and a trailing '\r') trimmed. Returns the number of fields found.
+int splitFields(const char* line, const char* lineEnd, const char** fields, int* lengths, int maxFields) {
+    if (lineEnd > line && lineEnd[-1] == '\r') lineEnd--;
+    int count = 0;
+    const char* fieldStart = line;
+    while (true) {
+        const char* fieldEnd = fieldStart;
+        while (fieldEnd < lineEnd && *fieldEnd != ',') fieldEnd++;
+        if (count == maxFields) return maxFields + 1;
+
+        const char* first = fieldStart;
+        const char* last = fieldEnd;
+        while (first < last && (*first == ' ' || *first == '\t')) first++;
+        while (last > first && (last[-1] == ' ' || last[-1] == '\t')) last--;
+        fields[count] = first;
+        lengths[count] = (int)(last - first);
+        count++;
+
+        if (fieldEnd == lineEnd) return count;
+        fieldStart = fieldEnd + 1;
+    }
+}
+
+// One parsed "from,to,travelTime" line; the ids point into the file it was read from
+struct RoadRecord {
+    const char* from;
+    const char* to;
+    int fromLength;
+    int toLength;
+    unsigned fromHash;
+    unsigned toHash;
+    int travelTime;
+};
+
+// Layout of the binary road-network file written by Graph::saveBinary. The header is followed by
+// 4-byte aligned arrays: id offsets (V + 1), id hashes (V), id characters (padded), road offsets
+// (V + 1), road targets (E) and road weights (E).
+struct BinaryNetworkHeader {
+    char magic[8];
+    unsigned version;
+    unsigned intersectionCount;
+    unsigned roadCount;
+    unsigned idBytes;
+    // Identity of the CSV it was built from, used to notice when that CSV has changed: its size,
+    // inode and modification and status change times to the nanosecond. Where stat has no
+    // nanoseconds or inodes (Windows) only the size and modification second are kept, so a
+    // rewrite of the same length within that second can slip through, as it can on a
+    // filesystem that keeps whole seconds only.
+    long long sourceSize;
+    long long sourceModified;
+    long long sourceModifiedNanoseconds;
+    long long sourceChanged;
+    long long sourceChangedNanoseconds;
+    unsigned long long sourceInode;
+    unsigned long long checksum; // Over everything after the header
+};
+
+const char BINARY_NETWORK_MAGIC[8] = {'R', 'O', 'A', 'D', 'N', 'E', 'T', '\0'};
+const unsigned BINARY_NETWORK_VERSION = 2;
+
+// Fills the source fields of header, leaving the ones this platform cannot tell at 0
+void stampSource(BinaryNetworkHeader& header, const struct stat& source) {
+    header.sourceSize = source.st_size;
+    header.sourceModified = source.st_mtime;
+    header.sourceModifiedNanoseconds = 0;
+    header.sourceChanged = 0;
+    header.sourceChangedNanoseconds = 0;
+    header.sourceInode = 0;
+#if defined(__linux__)
+    header.sourceModifiedNanoseconds = source.st_mtim.tv_nsec;
+    header.sourceChanged = source.st_ctim.tv_sec;
+    header.sourceChangedNanoseconds = source.st_ctim.tv_nsec;
+    header.sourceInode = source.st_ino;
+#elif defined(__APPLE__)
+    header.sourceModifiedNanoseconds = source.st_mtimespec.tv_nsec;
+    header.sourceChanged = source.st_ctimespec.tv_sec;
+    header.sourceChangedNanoseconds = source.st_ctimespec.tv_nsec;
+    header.sourceInode = source.st_ino;
+#endif
+}
+
+// 64-bit FNV-1a over 4-byte words, continuing from hash. Every section of the binary network
+// format is a multiple of 4 bytes, so sections can be hashed one after another.
+unsigned long long checksumBytes(const char* data, size_t length, unsigned long long hash = 14695981039346656037ull) {
+    size_t words = length / 4;
+    for (size_t i = 0; i < words; ++i) {
+        unsigned word;
+        memcpy(&word, data + 4 * i, 4);
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (size_t i = words * 4; i < length; ++i) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Contraction hierarchy over a road snapshot. Intersections are contracted one by one in order of
+// edge difference plus depth (lazily re-evaluated); contracting v adds a shortcut u->x for every
+// u->v->x that has no equally short witness path avoiding v. A query then only searches upward
+// in rank from the start and, backward, from the destination, meeting at the highest intersection.
+class ContractionHierarchy {
+    struct HierarchyEdge {
+        int from;
+        int to;
+        int weight;
+        int firstHalf;  // For shortcuts, the two edges they replace; -1 for roads
+        int secondHalf;
     };
 
-    struct Intersection {
-        char intersection;
-        Road* head;
-    };
+    int intersectionCount;
+    vector<HierarchyEdge> edges;
+    int* ranks;
+    int shortcutCount;
+
+    // Edges leading to a higher rank: upward ones stored at their tail for the forward search,
+    // downward ones stored at their head for the backward search
+    int* upOffsets;
+    int* upEdges;
+    int* downOffsets;
+    int* downEdges;
+
+    // Contraction-time state
+    vector<int>* outEdges; // Edges between not yet contracted intersections
+    vector<int>* inEdges;
+    bool* contracted;
+    int* levels; // Depth of the contracted intersections below each one
+    int* witnessDistances;
+    vector<int> witnessTouched;
+    MinHeap* witnessHeap;
+    int* targetMarks; // Equal to targetStamp for the heads of the edges leaving the current node
+    int targetStamp;
+    vector<bool> replaced; // Per edge, whether a shorter edge between the same intersections took its place
+
+    // Adds from->to unless an equal or shorter edge joins them already; a longer one is replaced
+    void addWorkingEdge(int from, int to, int weight, int firstHalf, int secondHalf) {
+        vector<int>& out = outEdges[from];
+        for (int k = 0; k < (int)out.size(); ++k) {
+            int existing = out[k];
+            if (edges[existing].to != to) continue;
+            if (edges[existing].weight <= weight) return;
+
+            // Nothing refers to the old edge yet: shortcuts only use edges of contracted intersections
+            replaced[existing] = true;
+            HierarchyEdge edge = { from, to, weight, firstHalf, secondHalf };
+            edges.push_back(edge);
+            replaced.push_back(false);
+            out[k] = (int)edges.size() - 1;
+            vector<int>& in = inEdges[to];
+            for (int j = 0; j < (int)in.size(); ++j) {
+                if (in[j] == existing) in[j] = out[k];
+            }
+            return;
+        }
+        HierarchyEdge edge = { from, to, weight, firstHalf, secondHalf };
+        edges.push_back(edge);
+        replaced.push_back(false);
+        out.push_back((int)edges.size() - 1);
+        inEdges[to].push_back((int)edges.size() - 1);
+    }
+
+    // Local Dijkstra from source among the remaining intersections, skipping via, that stops once
+    // the marked targets are settled and gives up past limit or after settleLimit settled
+    // intersections
+    void witnessSearch(int source, int via, int limit, int targets, int settleLimit) {
+        for (int k = 0; k < (int)witnessTouched.size(); ++k) {
+            witnessDistances[witnessTouched[k]] = UNREACHABLE;
+        }
+        witnessTouched.clear();
+        witnessHeap->clear();
+
+        witnessDistances[source] = 0;
+        witnessTouched.push_back(source);
+        witnessHeap->push(source, 0);
+        int settled = 0;
+        while (!witnessHeap->empty() && witnessHeap->topKey() <= limit && settled < settleLimit) {
+            int current = witnessHeap->pop();
+            settled++;
+            if (targetMarks[current] == targetStamp && --targets == 0) break;
+            const vector<int>& out = outEdges[current];
+            for (int k = 0; k < (int)out.size(); ++k) {
+                const HierarchyEdge& edge = edges[out[k]];
+                if (edge.to == via || contracted[edge.to]) continue;
+                int candidate = witnessDistances[current] + edge.weight;
+                if (candidate < witnessDistances[edge.to]) {
+                    if (witnessDistances[edge.to] == UNREACHABLE) witnessTouched.push_back(edge.to);
+                    witnessDistances[edge.to] = candidate;
+                    witnessHeap->push(edge.to, candidate);
+                }
+            }
+        }
+    }
+
+    // Counts the shortcuts contracting v needs, adding them when apply is set
+    int contract(int v, bool apply) {
+        int shortcuts = 0;
+        // Copied because adding shortcuts can reallocate the lists of v's neighbours
+        vector<int> in = inEdges[v];
+        vector<int> out = outEdges[v];
+        targetStamp++;
+        int targets = 0;
+        for (int j = 0; j < (int)out.size(); ++j) {
+            if (targetMarks[edges[out[j]].to] != targetStamp) {
+                targetMarks[edges[out[j]].to] = targetStamp;
+                targets++;
+            }
+        }
+        for (int i = 0; i < (int)in.size(); ++i) {
+            HierarchyEdge incoming = edges[in[i]];
+            if (incoming.from == v) continue;
+
+            int limit = -1;
+            for (int j = 0; j < (int)out.size(); ++j) {
+                const HierarchyEdge& outgoing = edges[out[j]];
+                if (outgoing.to != incoming.from && outgoing.to != v &&
+                    incoming.weight + outgoing.weight > limit) {
+                    limit = incoming.weight + outgoing.weight;
+                }
+            }
+            if (limit < 0) continue;
+
+            // Priorities only need an estimate, so simulated contractions search less
+            witnessSearch(incoming.from, v, limit, targets, apply ? 500 : 50);
+            for (int j = 0; j < (int)out.size(); ++j) {
+                HierarchyEdge outgoing = edges[out[j]];
+                if (outgoing.to == incoming.from || outgoing.to == v) continue;
+                int through = incoming.weight + outgoing.weight;
+                if (witnessDistances[outgoing.to] <= through) continue;
+                shortcuts++;
+                if (apply) addWorkingEdge(incoming.from, outgoing.to, through, in[i], out[j]);
+            }
+        }
+        return shortcuts;
+    }
+
+    int priority(int v) {
+        return contract(v, false) - (int)inEdges[v].size() - (int)outEdges[v].size() + levels[v];
+    }
+
+    // Removes edges towards v from its neighbours' lists once v is contracted
+    void detach(int v) {
+        for (int i = 0; i < (int)inEdges[v].size(); ++i) {
+            int from = edges[inEdges[v][i]].from;
+            if (from == v) continue;
+            vector<int>& out = outEdges[from];
+            for (int k = 0; k < (int)out.size(); ++k) {
+                if (edges[out[k]].to == v) {
+                    out[k] = out.back();
+                    out.pop_back();
+                    break;
+                }
+            }
+            if (levels[from] < levels[v] + 1) levels[from] = levels[v] + 1;
+        }
+        for (int i = 0; i < (int)outEdges[v].size(); ++i) {
+            int to = edges[outEdges[v][i]].to;
+            if (to == v) continue;
+            vector<int>& in = inEdges[to];
+            for (int k = 0; k < (int)in.size(); ++k) {
+                if (edges[in[k]].from == v) {
+                    in[k] = in.back();
+                    in.pop_back();
+                    break;
+                }
+            }
+            if (levels[to] < levels[v] + 1) levels[to] = levels[v] + 1;
+        }
+    }
+
+public:
+    // Contracts the graph given as a CSR snapshot with `count` intersections
+    ContractionHierarchy(int count, const int* roadOffsets, const int* roadTargets, const int* roadWeights)
+        : intersectionCount(count) {
+        int size = count > 0 ? count : 1;
+        ranks = new int[size];
+        outEdges = new vector<int>[size];
+        inEdges = new vector<int>[size];
+        contracted = new bool[size]();
+        levels = new int[size]();
+        witnessDistances = new int[size];
+        witnessHeap = new MinHeap(size);
+        targetMarks = new int[size]();
+        targetStamp = 0;
+        for (int i = 0; i < count; ++i) witnessDistances[i] = UNREACHABLE;
+
+        for (int from = 0; from < count; ++from) {
+            for (int r = roadOffsets[from]; r < roadOffsets[from + 1]; ++r) {
+                // Closed roads (UNREACHABLE) would only add shortcuts that overflow
+                if (roadTargets[r] != from && roadWeights[r] < UNREACHABLE) {
+                    addWorkingEdge(from, roadTargets[r], roadWeights[r], -1, -1);
+                }
+            }
+        }
+
+        // Order by priority, re-evaluating the cheapest candidate before contracting it
+        MinHeap order(size);
+        for (int v = 0; v < count; ++v) order.push(v, priority(v));
+        int nextRank = 0;
+        while (!order.empty()) {
+            int v = order.pop();
+            int current = priority(v);
+            if (!order.empty() && current > order.topKey()) {
+                order.push(v, current);
+                continue;
+            }
+            contract(v, true);
+            detach(v);
+            contracted[v] = true;
+            ranks[v] = nextRank++;
+        }
+
+        delete[] outEdges;
+        delete[] inEdges;
+        delete[] contracted;
+        delete[] levels;
+        delete[] witnessDistances;
+        delete witnessHeap;
+        delete[] targetMarks;
+        witnessTouched.clear();
+
+        // Split every edge still in use into the upward and downward graphs by the ranks of its ends
+        upOffsets = new int[count + 1]();
+        downOffsets = new int[count + 1]();
+        shortcutCount = 0;
+        for (int e = 0; e < (int)edges.size(); ++e) {
+            if (replaced[e]) continue;
+            if (edges[e].firstHalf != -1) shortcutCount++;
+            if (ranks[edges[e].from] < ranks[edges[e].to]) upOffsets[edges[e].from + 1]++;
+            else downOffsets[edges[e].to + 1]++;
+        }
+        for (int i = 0; i < count; ++i) {
+            upOffsets[i + 1] += upOffsets[i];
+            downOffsets[i + 1] += downOffsets[i];
+        }
+        upEdges = new int[upOffsets[count] > 0 ? upOffsets[count] : 1];
+        downEdges = new int[downOffsets[count] > 0 ? downOffsets[count] : 1];
+        int* upFill = new int[size];
+        int* downFill = new int[size];
+        for (int i = 0; i < count; ++i) {
+            upFill[i] = upOffsets[i];
+            downFill[i] = downOffsets[i];
+        }
+        for (int e = 0; e < (int)edges.size(); ++e) {
+            if (replaced[e]) continue;
+            if (ranks[edges[e].from] < ranks[edges[e].to]) upEdges[upFill[edges[e].from]++] = e;
+            else downEdges[downFill[edges[e].to]++] = e;
+        }
+        delete[] upFill;
+        delete[] downFill;
+        replaced = vector<bool>();
+    }
+
+    ~ContractionHierarchy() {
+        delete[] ranks;
+        delete[] upOffsets;
+        delete[] upEdges;
+        delete[] downOffsets;
+        delete[] downEdges;
+    }
+
+    int getShortcutCount() const {
+        return shortcutCount;
+    }
+
+    // Upward search from startIndex and backward upward search from endIndex. The forward half of
+    // the buffers must be reset and startIndex touched by the caller; afterwards predecessors and
+    // successors hold the hierarchy edge each intersection was reached by, and meeting the joining
+    // intersection. Returns the travel time, UNREACHABLE if there is no path.
+    int query(int startIndex, int endIndex, SearchBuffers& buffers) const {
+        buffers.resetBackward();
+        buffers.touchBackward(endIndex);
+        MinHeap& forward = buffers.heap;
+        MinHeap& backward = buffers.backwardHeap;
+        forward.clear();
+        backward.clear();
+        buffers.distances[startIndex] = 0;
+        buffers.backwardDistances[endIndex] = 0;
+        forward.push(startIndex, 0);
+        backward.push(endIndex, 0);
+
+        int best = UNREACHABLE;
+        buffers.meeting = -1;
+        if (startIndex == endIndex) {
+            best = 0;
+            buffers.meeting = startIndex;
+        }
+
+        while (true) {
+            bool forwardOpen = !forward.empty() && forward.topKey() < best;
+            bool backwardOpen = !backward.empty() && backward.topKey() < best;
+            if (!forwardOpen && !backwardOpen) break;
+
+            bool isForward = forwardOpen && (!backwardOpen || forward.topKey() <= backward.topKey());
+            MinHeap& queue = isForward ? forward : backward;
+            int* distances = isForward ? buffers.distances : buffers.backwardDistances;
+            int* parents = isForward ? buffers.predecessors : buffers.successors;
+            const int* offsets = isForward ? upOffsets : downOffsets;
+            const int* adjacent = isForward ? upEdges : downEdges;
+
+            int current = queue.pop();
+            PROFILE_COUNT(SETTLED_NODES, 1);
+            PROFILE_COUNT(RELAXED_EDGES, offsets[current + 1] - offsets[current]);
+            int other = isForward ? buffers.backwardDistance(current) : buffers.distance(current);
+            if (other != UNREACHABLE && distances[current] + other < best) {
+                best = distances[current] + other;
+                buffers.meeting = current;
+            }
+            for (int k = offsets[current]; k < offsets[current + 1]; ++k) {
+                const HierarchyEdge& edge = edges[adjacent[k]];
+                int neighborIndex = isForward ? edge.to : edge.from;
+                if (isForward) buffers.touch(neighborIndex);
+                else buffers.touchBackward(neighborIndex);
+                int candidate = distances[current] + edge.weight;
+                if (candidate < distances[neighborIndex]) {
+                    distances[neighborIndex] = candidate;
+                    parents[neighborIndex] = adjacent[k];
+                    queue.push(neighborIndex, candidate);
+                }
+            }
+        }
+        return best;
+    }
+
+    // Expands the hierarchy path left in the buffers by query into the roads it stands for
+    void unpack(const SearchBuffers& buffers, Route& route) const {
+        // Stack of hierarchy edges with the next one on top: the part after the meeting point
+        // goes in last edge first, then the part before it from the meeting point back
+        vector<int> pending;
+        for (int at = buffers.meeting; buffers.successors[at] != -1; at = edges[buffers.successors[at]].to) {
+            pending.push_back(buffers.successors[at]);
+        }
+        for (int i = 0, j = (int)pending.size() - 1; i < j; ++i, --j) {
+            int temp = pending[i];
+            pending[i] = pending[j];
+            pending[j] = temp;
+        }
+        int at = buffers.meeting;
+        while (buffers.predecessors[at] != -1) {
+            pending.push_back(buffers.predecessors[at]);
+            at = edges[buffers.predecessors[at]].from;
+        }
+        route.push_back(at);
+
+        while (!pending.empty()) {
+            int e = pending.back();
+            pending.pop_back();
+            if (edges[e].firstHalf == -1) {
+                route.push_back(edges[e].to);
+            } else {
+                pending.push_back(edges[e].secondHalf);
+                pending.push_back(edges[e].firstHalf);
+            }
+        }
+    }
+};
+
+class Graph {
+    struct Road {
+        int to; // Index of the neighbouring intersection in adjLists
+        int length;
+        Road* next;
+    };
+
+    struct Intersection {
+        string intersection;
+        unsigned hash; // hashId of the id, kept for rehashing
+        Road* head;
+    };
+
+    Intersection* adjLists;
+    int intersectionCount;
+    int capacity;
+    int roadCount;
+    SlabArena<Road> roads; // Owns every Road node
+
+    // Open-addressing hash table from intersection id to its index in adjLists (-1 marks a free slot)
+    int* idSlots;
+    int idSlotMask;
+    int longestId; // Length of the longest intersection id, see getIdSeparator
+
+    // Read-only compressed-sparse-row copy of the roads used for routing, built by freeze().
+    // Roads of intersection i are roadTargets/roadWeights[roadOffsets[i] .. roadOffsets[i + 1]).
+    // Every const query reads it, so freeze() must run after the last edit and before them.
+    int* roadOffsets;
+    int* roadTargets;
+    int* roadWeights;
+    bool frozen;
+
+    // Incoming roads of every intersection, built with the snapshot: the roads arriving at i are
+    // reverseRoads[reverseOffsets[i] .. reverseOffsets[i + 1]), coming from reverseSources at
+    // the same positions. reverseRoads holds snapshot road indices, so weights stay in roadWeights.
+    int* reverseOffsets;
+    int* reverseSources;
+    int* reverseRoads;
+    MappedFile* snapshotFile; // Set when the snapshot arrays live in a loaded binary file
+
+    // False after a bulk load, which fills only the snapshot; the Road lists are rebuilt
+    // from it on the first edit
+    bool roadsListed;
+
+    RoutingMode routingMode;
+    PathCache* pathCache; // Optional, see setPathCacheCapacity
+    ContractionHierarchy* hierarchy; // Optional, see buildContractionHierarchy
+    SearchBuffers* workspace; // Kept across findShortestPath calls, sized on first use
+
+    // Optional landmarks for ALT, see selectLandmarks. Travel times from landmark l to
+    // intersection v and back are fromLandmarks/toLandmarks[v * landmarkCount + l], so the bounds
+    // for one intersection share a cache line.
+    int* landmarks;
+    int landmarkCount;
+    int* fromLandmarks;
+    int* toLandmarks;
+
+    // Optional positions of the first coordinateCount intersections, see loadCoordinates.
+    // heuristicScale is the smallest travel time per unit of distance over all roads, so the
+    // straight-line distance times it never overestimates the rest of a trip.
+    double* coordinateX;
+    double* coordinateY;
+    int coordinateCount;
+    double heuristicScale;
+
+    int findIndex(const char* id, int length, unsigned hash) const {
+        PROFILE_COUNT(FIND_INDEX_CALLS, 1);
+        for (int slot = hash & idSlotMask; idSlots[slot] != -1; slot = (slot + 1) & idSlotMask) {
+            const Intersection& candidate = adjLists[idSlots[slot]];
+            if (candidate.hash == hash && (int)candidate.intersection.length() == length &&
+                memcmp(candidate.intersection.data(), id, length) == 0) {
+                return idSlots[slot];
+            }
+        }
+        return -1;
+    }
+
+    int findIndex(const string& intersection) const {
+        return findIndex(intersection.data(), (int)intersection.length(),
+                         hashId(intersection.data(), (int)intersection.length()));
+    }
+
+    // Keeps the id table at most half full
+    void growIdSlots() {
+        if (2 * (intersectionCount + 1) <= idSlotMask + 1) return;
+        int slotCount = 2 * (idSlotMask + 1);
+        delete[] idSlots;
+        idSlots = new int[slotCount];
+        idSlotMask = slotCount - 1;
+        for (int i = 0; i < slotCount; ++i) idSlots[i] = -1;
+        for (int i = 0; i < intersectionCount; ++i) {
+            int slot = adjLists[i].hash & idSlotMask;
+            while (idSlots[slot] != -1) slot = (slot + 1) & idSlotMask;
+            idSlots[slot] = i;
+        }
+    }
+
+    // Appends an intersection that is known not to exist yet and returns its index
+    int insertIntersection(const char* id, int length, unsigned hash) {
+        resizeIfNeeded();
+        growIdSlots();
+        adjLists[intersectionCount].intersection.assign(id, length);
+        adjLists[intersectionCount].hash = hash;
+        if (length > longestId) longestId = length;
+        adjLists[intersectionCount].head = nullptr;
+
+        int slot = hash & idSlotMask;
+        while (idSlots[slot] != -1) slot = (slot + 1) & idSlotMask;
+        idSlots[slot] = intersectionCount;
+        return intersectionCount++;
+    }
+
+    int findOrInsert(const char* id, int length, unsigned hash) {
+        int index = findIndex(id, length, hash);
+        return (index != -1) ? index : insertIntersection(id, length, hash);
+    }
+
+    Road* createRoad(int to, int length) {
+        Road* newRoad = roads.allocate();
+        newRoad->to = to;
+        newRoad->length = length;
+        newRoad->next = nullptr;
+        return newRoad;
+    }
+
+    void buildSnapshot() {
+        PROFILE_SCOPE("build snapshot");
+        roadOffsets = new int[intersectionCount + 1];
+        roadTargets = new int[roadCount];
+        roadWeights = new int[roadCount];
+
+        int next = 0;
+        for (int i = 0; i < intersectionCount; ++i) {
+            roadOffsets[i] = next;
+            for (Road* current = adjLists[i].head; current; current = current->next) {
+                roadTargets[next] = current->to;
+                roadWeights[next] = current->length;
+                next++;
+            }
+        }
+        roadOffsets[intersectionCount] = next;
+        buildReverseSnapshot();
+        updateHeuristicScale();
+        frozen = true;
+    }
+
+    bool hasCoordinates() const {
+        return coordinateCount > 0 && coordinateCount == intersectionCount;
+    }
+
+    // Recomputes heuristicScale from the snapshot roads. Roads joining two intersections at the
+    // same position do not constrain it.
+    void updateHeuristicScale() {
+        if (!hasCoordinates()) return;
+        double scale = -1;
+        for (int from = 0; from < intersectionCount; ++from) {
+            for (int r = roadOffsets[from]; r < roadOffsets[from + 1]; ++r) {
+                double dx = coordinateX[roadTargets[r]] - coordinateX[from];
+                double dy = coordinateY[roadTargets[r]] - coordinateY[from];
+                double distance = sqrt(dx * dx + dy * dy);
+                if (distance > 0 && (scale < 0 || roadWeights[r] / distance < scale)) {
+                    scale = roadWeights[r] / distance;
+                }
+            }
+        }
+        // Shaved slightly so rounding can never push the bound above a real travel time
+        heuristicScale = (scale < 0) ? 0 : scale * (1 - 1e-9);
+    }
+
+    // Lower bound on the travel time from index to endIndex by the triangle inequality over every
+    // landmark, or UNREACHABLE when the landmarks show endIndex cannot be reached from index
+    int landmarkBound(int index, int endIndex) const {
+        const int* fromIndex = fromLandmarks + (size_t)index * landmarkCount;
+        const int* fromEnd = fromLandmarks + (size_t)endIndex * landmarkCount;
+        const int* toIndex = toLandmarks + (size_t)index * landmarkCount;
+        const int* toEnd = toLandmarks + (size_t)endIndex * landmarkCount;
+        int bound = 0;
+        for (int l = 0; l < landmarkCount; ++l) {
+            if (fromIndex[l] != UNREACHABLE) {
+                if (fromEnd[l] == UNREACHABLE) return UNREACHABLE; // Else landmark -> index -> end
+                if (fromEnd[l] - fromIndex[l] > bound) bound = fromEnd[l] - fromIndex[l];
+            }
+            if (toEnd[l] != UNREACHABLE) {
+                if (toIndex[l] == UNREACHABLE) return UNREACHABLE; // Else index -> end -> landmark
+                if (toIndex[l] - toEnd[l] > bound) bound = toIndex[l] - toEnd[l];
+            }
+        }
+        return bound;
+    }
+
+    // Lower bound on the travel time from index to endIndex
+    int heuristic(int index, int endIndex) const {
+        if (routingMode == ALT) return landmarkBound(index, endIndex);
+        double dx = coordinateX[endIndex] - coordinateX[index];
+        double dy = coordinateY[endIndex] - coordinateY[index];
+        return (int)(sqrt(dx * dx + dy * dy) * heuristicScale);
+    }
+
+    void buildReverseSnapshot() {
+        reverseOffsets = new int[intersectionCount + 1]();
+        reverseSources = new int[roadCount > 0 ? roadCount : 1];
+        reverseRoads = new int[roadCount > 0 ? roadCount : 1];
+        for (int r = 0; r < roadCount; ++r) {
+            reverseOffsets[roadTargets[r] + 1]++;
+        }
+        for (int i = 0; i < intersectionCount; ++i) {
+            reverseOffsets[i + 1] += reverseOffsets[i];
+        }
+
+        int* fill = new int[intersectionCount > 0 ? intersectionCount : 1];
+        for (int i = 0; i < intersectionCount; ++i) {
+            fill[i] = reverseOffsets[i];
+        }
+        for (int from = 0; from < intersectionCount; ++from) {
+            for (int r = roadOffsets[from]; r < roadOffsets[from + 1]; ++r) {
+                int slot = fill[roadTargets[r]]++;
+                reverseSources[slot] = from;
+                reverseRoads[slot] = r;
+            }
+        }
+        delete[] fill;
+    }
+
+    void releaseSnapshot() {
+        if (snapshotFile) {
+            delete snapshotFile;
+            snapshotFile = nullptr;
+        } else {
+            delete[] roadOffsets;
+            delete[] roadTargets;
+            delete[] roadWeights;
+        }
+        delete[] reverseOffsets;
+        delete[] reverseSources;
+        delete[] reverseRoads;
+        roadOffsets = roadTargets = roadWeights = nullptr;
+        reverseOffsets = reverseSources = reverseRoads = nullptr;
+        frozen = false;
+    }
+
+    // Recreates the Road lists from the snapshot, in the same order
+    void listRoads() {
+        roads.reserve(roadCount);
+        for (int i = 0; i < intersectionCount; ++i) {
+            for (int r = roadOffsets[i + 1] - 1; r >= roadOffsets[i]; --r) {
+                Road* newRoad = createRoad(roadTargets[r], roadWeights[r]);
+                newRoad->next = adjLists[i].head;
+                adjLists[i].head = newRoad;
+            }
+        }
+        roadsListed = true;
+    }
+
+    // Called before any change to the roads or intersections
+    void beginEdit() {
+        if (!roadsListed) listRoads();
+        releaseSnapshot();
+        delete hierarchy;
+        hierarchy = nullptr;
+        releaseLandmarks();
+    }
+
+    // Settles intersections outward from startIndex, stopping early once endIndex is
+    // settled (pass -1 to build the full shortest-path tree)
+    void runDijkstra(int startIndex, int endIndex, SearchBuffers& buffers) const {
+        int* distances = buffers.distances;
+        int* predecessors = buffers.predecessors;
+        bool* visited = buffers.visited;
+
+        if (routingMode == RADIX_HEAP) {
+            RadixHeap& queue = buffers.radix;
+            queue.clear();
+            queue.push(startIndex, 0);
+            while (!queue.empty()) {
+                int key;
+                int current = queue.pop(key);
+                if (visited[current] || key > distances[current]) continue;
+                visited[current] = true;
+                PROFILE_COUNT(SETTLED_NODES, 1);
+                if (current == endIndex) break;
+                PROFILE_COUNT(RELAXED_EDGES, roadOffsets[current + 1] - roadOffsets[current]);
+
+                for (int r = roadOffsets[current]; r < roadOffsets[current + 1]; ++r) {
+                    int neighborIndex = roadTargets[r];
+                    buffers.touch(neighborIndex);
+                    int candidate = distances[current] + roadWeights[r];
+                    if (!visited[neighborIndex] && candidate < distances[neighborIndex]) {
+                        distances[neighborIndex] = candidate;
+                        predecessors[neighborIndex] = current;
+                        queue.push(neighborIndex, candidate);
+                    }
+                }
+            }
+        } else {
+            MinHeap& queue = buffers.heap;
+            queue.clear();
+            queue.push(startIndex, 0);
+            while (!queue.empty()) {
+                int current = queue.pop();
+                visited[current] = true;
+                PROFILE_COUNT(SETTLED_NODES, 1);
+                if (current == endIndex) break;
+                PROFILE_COUNT(RELAXED_EDGES, roadOffsets[current + 1] - roadOffsets[current]);
+
+                for (int r = roadOffsets[current]; r < roadOffsets[current + 1]; ++r) {
+                    int neighborIndex = roadTargets[r];
+                    buffers.touch(neighborIndex);
+                    int candidate = distances[current] + roadWeights[r];
+                    if (!visited[neighborIndex] && candidate < distances[neighborIndex]) {
+                        distances[neighborIndex] = candidate;
+                        predecessors[neighborIndex] = current;
+                        queue.push(neighborIndex, candidate);
+                    }
+                }
+            }
+        }
+    }
+
+    // Dijkstra keyed by distance plus a lower bound on the rest of the trip (straight-line or
+    // landmark). Both bounds are consistent, so an intersection is final once settled and the
+    // search can stop at endIndex.
+    void runAStar(int startIndex, int endIndex, SearchBuffers& buffers) const {
+        int* distances = buffers.distances;
+        int* predecessors = buffers.predecessors;
+        bool* visited = buffers.visited;
+
+        MinHeap& queue = buffers.heap;
+        queue.clear();
+        queue.push(startIndex, heuristic(startIndex, endIndex));
+        while (!queue.empty()) {
+            int current = queue.pop();
+            visited[current] = true;
+            PROFILE_COUNT(SETTLED_NODES, 1);
+            if (current == endIndex) break;
+            PROFILE_COUNT(RELAXED_EDGES, roadOffsets[current + 1] - roadOffsets[current]);
+
+            for (int r = roadOffsets[current]; r < roadOffsets[current + 1]; ++r) {
+                int neighborIndex = roadTargets[r];
+                buffers.touch(neighborIndex);
+                int candidate = distances[current] + roadWeights[r];
+                if (!visited[neighborIndex] && candidate < distances[neighborIndex]) {
+                    int bound = heuristic(neighborIndex, endIndex);
+                    if (bound == UNREACHABLE) continue; // endIndex is out of reach from there
+                    distances[neighborIndex] = candidate;
+                    predecessors[neighborIndex] = current;
+                    queue.push(neighborIndex, candidate + bound);
+                }
+            }
+        }
+    }
+
+    // Grows one search frontier by settling its closest intersection. Each relaxation that lowers
+    // a distance also checks whether the other frontier has reached that intersection.
+    void settleBidirectional(bool forward, SearchBuffers& buffers, int& best) const {
+        MinHeap& queue = forward ? buffers.heap : buffers.backwardHeap;
+        int* distances = forward ? buffers.distances : buffers.backwardDistances;
+        int* parents = forward ? buffers.predecessors : buffers.successors;
+        bool* visited = forward ? buffers.visited : buffers.backwardVisited;
+        const int* offsets = forward ? roadOffsets : reverseOffsets;
+
+        int current = queue.pop();
+        visited[current] = true;
+        PROFILE_COUNT(SETTLED_NODES, 1);
+        PROFILE_COUNT(RELAXED_EDGES, offsets[current + 1] - offsets[current]);
+        for (int k = offsets[current]; k < offsets[current + 1]; ++k) {
+            int neighborIndex = forward ? roadTargets[k] : reverseSources[k];
+            if (forward) buffers.touch(neighborIndex);
+            else buffers.touchBackward(neighborIndex);
+            int candidate = distances[current] + roadWeights[forward ? k : reverseRoads[k]];
+            if (!visited[neighborIndex] && candidate < distances[neighborIndex]) {
+                distances[neighborIndex] = candidate;
+                parents[neighborIndex] = current;
+                queue.push(neighborIndex, candidate);
+                int other = forward ? buffers.backwardDistance(neighborIndex) : buffers.distance(neighborIndex);
+                if (other != UNREACHABLE && candidate + other < best) {
+                    best = candidate + other;
+                    buffers.meeting = neighborIndex;
+                }
+            }
+        }
+    }
+
+    // Searches forward from startIndex and backward from endIndex, always growing the frontier with
+    // the closer top entry, until the two closest unsettled entries cannot beat the best meeting
+    void runBidirectional(int startIndex, int endIndex, SearchBuffers& buffers) const {
+        buffers.resetBackward();
+        buffers.touchBackward(endIndex);
+        buffers.heap.clear();
+        buffers.backwardHeap.clear();
+        buffers.backwardDistances[endIndex] = 0;
+        buffers.heap.push(startIndex, 0);
+        buffers.backwardHeap.push(endIndex, 0);
+
+        int best = UNREACHABLE;
+        if (startIndex == endIndex) {
+            best = 0;
+            buffers.meeting = startIndex;
+        }
+
+        while (!buffers.heap.empty() && !buffers.backwardHeap.empty()) {
+            int forwardTop = buffers.heap.topKey();
+            int backwardTop = buffers.backwardHeap.topKey();
+            if (forwardTop + backwardTop >= best) break;
+            settleBidirectional(forwardTop <= backwardTop, buffers, best);
+        }
+        buffers.touch(endIndex);
+        buffers.distances[endIndex] = best;
+    }
+
+    void search(int startIndex, int endIndex, SearchBuffers& buffers) const {
+        assert(frozen); // See freeze()
+
+        // Only a full tree needs every entry initialised
+        if (endIndex == -1) buffers.resetAll();
+        else buffers.reset();
+        buffers.meeting = -1;
+        buffers.hierarchical = false;
+
+        if (startIndex == -1) return;
+        buffers.touch(startIndex);
+        buffers.distances[startIndex] = 0;
+        if (routingMode == CONTRACTION_HIERARCHY && endIndex != -1 && hierarchy) {
+            int distance = hierarchy->query(startIndex, endIndex, buffers);
+            buffers.touch(endIndex);
+            buffers.distances[endIndex] = distance;
+            buffers.hierarchical = true;
+        } else if (routingMode == BIDIRECTIONAL && endIndex != -1) {
+            runBidirectional(startIndex, endIndex, buffers);
+        } else if (routingMode == ASTAR && endIndex != -1 && hasCoordinates()) {
+            runAStar(startIndex, endIndex, buffers);
+        } else if (routingMode == ALT && endIndex != -1 && landmarkCount > 0) {
+            runAStar(startIndex, endIndex, buffers);
+        } else {
+            runDijkstra(startIndex, endIndex, buffers);
+        }
+    }
+
+    // Travel times from source to every intersection, or from every intersection to source when
+    // reverse is set, left in buffers.distances with the tree in buffers.predecessors. With targets (a flag per intersection, targetCount
+    // of them set) the search stops once all of those are settled.
+    void searchAll(int source, bool reverse, SearchBuffers& buffers,
+                   const bool* targets = nullptr, int targetCount = 0) const {
+        const int* offsets = reverse ? reverseOffsets : roadOffsets;
+        int* distances = buffers.distances;
+        int* parents = buffers.predecessors;
+        bool* visited = buffers.visited;
+        buffers.resetAll();
+
+        MinHeap& queue = buffers.heap;
+        queue.clear();
+        distances[source] = 0;
+        queue.push(source, 0);
+        while (!queue.empty()) {
+            int current = queue.pop();
+            visited[current] = true;
+            PROFILE_COUNT(SETTLED_NODES, 1);
+            if (targets && targets[current] && --targetCount == 0) break;
+            PROFILE_COUNT(RELAXED_EDGES, offsets[current + 1] - offsets[current]);
+
+            for (int k = offsets[current]; k < offsets[current + 1]; ++k) {
+                int neighborIndex = reverse ? reverseSources[k] : roadTargets[k];
+                int candidate = distances[current] + roadWeights[reverse ? reverseRoads[k] : k];
+                if (!visited[neighborIndex] && candidate < distances[neighborIndex]) {
+                    distances[neighborIndex] = candidate;
+                    parents[neighborIndex] = current;
+                    queue.push(neighborIndex, candidate);
+                }
+            }
+        }
+    }
+
+    // Relaxes block (rowBlock, columnBlock) of an all-pairs table through the intersections of
+    // block throughBlock
+    static void relaxBlock(int* table, int size, int rowBlock, int columnBlock, int throughBlock) {
+        const int block = 64;
+        int onward[block];
+        for (int k = throughBlock * block; k < (throughBlock + 1) * block; ++k) {
+            // A local copy of row k's slice cannot alias the rows being relaxed, which lets the
+            // compiler vectorise the inner loop
+            const int* throughRow = table + (size_t)k * size + columnBlock * block;
+            for (int j = 0; j < block; ++j) onward[j] = throughRow[j];
+
+            for (int i = rowBlock * block; i < (rowBlock + 1) * block; ++i) {
+                int* row = table + (size_t)i * size + columnBlock * block;
+                int toThrough = table[(size_t)i * size + k];
+                for (int j = 0; j < block; ++j) {
+                    int candidate = toThrough + onward[j];
+                    row[j] = (candidate < row[j]) ? candidate : row[j];
+                }
+            }
+        }
+    }
+
+    // Floyd-Warshall over 64x64 blocks of a size x size table (size a multiple of 64): for each
+    // diagonal block, first the block itself, then its row and column, then all the others, the
+    // last two steps spread over the pool. Unreachable entries hold UNREACHABLE, and the sum of two
+    // of them still fits in an int.
+    static void floydWarshall(int* table, int size, WorkerPool& pool) {
+        int blocks = size / 64;
+        for (int through = 0; through < blocks; ++through) {
+            relaxBlock(table, size, through, through, through);
+            pool.run(blocks, 1, [&](int begin, int end, int) {
+                for (int b = begin; b < end; ++b) {
+                    if (b == through) continue;
+                    relaxBlock(table, size, through, b, through);
+                    relaxBlock(table, size, b, through, through);
+                }
+            });
+            pool.run(blocks, 1, [&](int begin, int end, int) {
+                for (int rowBlock = begin; rowBlock < end; ++rowBlock) {
+                    if (rowBlock == through) continue;
+                    for (int columnBlock = 0; columnBlock < blocks; ++columnBlock) {
+                        if (columnBlock != through) relaxBlock(table, size, rowBlock, columnBlock, through);
+                    }
+                }
+            });
+        }
+    }
+
+    void releaseLandmarks() {
+        delete[] landmarks;
+        delete[] fromLandmarks;
+        delete[] toLandmarks;
+        landmarks = fromLandmarks = toLandmarks = nullptr;
+        landmarkCount = 0;
+    }
+
+    void resizeIfNeeded() {
+        if (intersectionCount == capacity) {
+            capacity = (capacity == 0) ? 1 : capacity * 2;
+            Intersection* newAdjLists = new Intersection[capacity];
+            for (int i = 0; i < intersectionCount; ++i) {
+                newAdjLists[i] = std::move(adjLists[i]);
+            }
+            delete[] adjLists;
+            adjLists = newAdjLists;
+        }
+    }
+
+public:
+    Graph()
+        : adjLists(nullptr), intersectionCount(0), capacity(0), roadCount(0),
+          roadOffsets(nullptr), roadTargets(nullptr), roadWeights(nullptr), frozen(false),
+          reverseOffsets(nullptr), reverseSources(nullptr), reverseRoads(nullptr), snapshotFile(nullptr),
+          roadsListed(true),
+          routingMode(BINARY_HEAP), pathCache(nullptr), hierarchy(nullptr), workspace(nullptr),
+          landmarks(nullptr), landmarkCount(0), fromLandmarks(nullptr), toLandmarks(nullptr),
+          coordinateX(nullptr), coordinateY(nullptr), coordinateCount(0), heuristicScale(0) {
+        idSlotMask = 15;
+        longestId = 0;
+        idSlots = new int[idSlotMask + 1];
+        for (int i = 0; i <= idSlotMask; ++i) idSlots[i] = -1;
+    }
+
+    ~Graph() {
+        roads.release();
+        delete[] adjLists;
+        delete[] idSlots;
+        releaseSnapshot();
+        delete pathCache;
+        delete hierarchy;
+        delete workspace;
+        releaseLandmarks();
+        delete[] coordinateX;
+        delete[] coordinateY;
+    }
+
+    // Remember up to `capacity` routes by (start, end); 0 turns the cache off
+    void setPathCacheCapacity(int capacity) {
+        delete pathCache;
+        pathCache = (capacity > 0) ? new PathCache(capacity) : nullptr;
+    }
+
+    const PathCache* getPathCache() const {
+        return pathCache;
+    }
+
+    void setRoutingMode(RoutingMode mode) {
+        routingMode = mode;
+    }
+
+    // Build the routing snapshot once loading is done; any later edit drops it again. The const
+    // queries only read the snapshot, so call this before them.
+    void freeze() {
+        if (!frozen) buildSnapshot();
+    }
+
+    // Preprocesses the current roads for CONTRACTION_HIERARCHY queries; any later edit drops
+    // the hierarchy and those queries fall back to Dijkstra until it is built again
+    void buildContractionHierarchy() {
+        PROFILE_SCOPE("build contraction hierarchy");
+        freeze();
+        delete hierarchy;
+        hierarchy = new ContractionHierarchy(intersectionCount, roadOffsets, roadTargets, roadWeights);
+    }
+
+    const ContractionHierarchy* getContractionHierarchy() const {
+        return hierarchy;
+    }
+
+    // Picks up to `count` landmarks for ALT queries and tabulates the travel times from and to
+    // each of them. Landmarks are chosen farthest-first: each new one is the intersection whose
+    // nearest landmark is farthest away (unreachable counts as farthest), which needs the travel
+    // times from the landmarks so far. The tables towards the landmarks are independent and are
+    // filled on the pool. Any later edit drops the landmarks.
+    void selectLandmarks(int count, WorkerPool& pool) {
+        PROFILE_SCOPE("select landmarks");
+        freeze();
+        releaseLandmarks();
+        if (count > intersectionCount) count = intersectionCount;
+        if (count <= 0) return;
+
+        landmarks = new int[count];
+        fromLandmarks = new int[(size_t)intersectionCount * count];
+        toLandmarks = new int[(size_t)intersectionCount * count];
+        int* nearest = new int[intersectionCount];
+        SearchBuffers buffers(intersectionCount);
+
+        // Start from the intersection farthest from an arbitrary one
+        searchAll(0, false, buffers);
+        for (int v = 0; v < intersectionCount; ++v) nearest[v] = buffers.distances[v];
+        for (int l = 0; l < count; ++l) {
+            int next = 0;
+            for (int v = 1; v < intersectionCount; ++v) {
+                if (nearest[v] > nearest[next]) next = v;
+            }
+            landmarks[l] = next;
+
+            searchAll(next, false, buffers);
+            for (int v = 0; v < intersectionCount; ++v) {
+                fromLandmarks[(size_t)v * count + l] = buffers.distances[v];
+                if (l == 0 || buffers.distances[v] < nearest[v]) nearest[v] = buffers.distances[v];
+            }
+        }
+        delete[] nearest;
+
+        SearchBuffers** workerBuffers = new SearchBuffers*[pool.size()];
+        for (int i = 0; i < pool.size(); ++i) workerBuffers[i] = nullptr;
+        pool.run(count, 1, [&](int begin, int end, int worker) {
+            if (!workerBuffers[worker]) workerBuffers[worker] = new SearchBuffers(intersectionCount);
+            for (int l = begin; l < end; ++l) {
+                searchAll(landmarks[l], true, *workerBuffers[worker]);
+                for (int v = 0; v < intersectionCount; ++v) {
+                    toLandmarks[(size_t)v * count + l] = workerBuffers[worker]->distances[v];
+                }
+            }
+        });
+        for (int i = 0; i < pool.size(); ++i) delete workerBuffers[i];
+        delete[] workerBuffers;
+
+        landmarkCount = count;
+    }
+
+    int getLandmarkCount() const {
+        return landmarkCount;
+    }
+
+    // Fills matrix, row-major originCount x destinationCount, with the travel times between the
+    // given intersection indices (UNREACHABLE where there is no path or an index is -1). Small graphs
+    // where that is cheaper get one blocked Floyd-Warshall over all pairs; otherwise the smaller
+    // side gets one search each on the pool, forward from the origins or backward from the
+    // destinations, each stopping once it has settled the whole other side.
+    void travelTimeMatrix(const int* origins, int originCount, const int* destinations, int destinationCount,
+                          int* matrix, WorkerPool& pool) const {
+        PROFILE_SCOPE("travel time matrix");
+        assert(frozen); // See freeze()
+        for (size_t i = 0; i < (size_t)originCount * destinationCount; ++i) {
+            matrix[i] = UNREACHABLE;
+        }
+        if (intersectionCount == 0 || originCount == 0 || destinationCount == 0) return;
+
+        bool backward = destinationCount < originCount;
+        const int* sources = backward ? destinations : origins;
+        int sourceCount = backward ? destinationCount : originCount;
+        const int* targets = backward ? origins : destinations;
+        int targetCount = backward ? originCount : destinationCount;
+
+        // Rough cost model: a vectorised Floyd-Warshall step against a heap-based search step
+        double searchCost = (double)sourceCount * (roadCount + intersectionCount * log2(intersectionCount + 1.0));
+        if (intersectionCount <= 2048 && (double)intersectionCount * intersectionCount * intersectionCount < 32 * searchCost) {
+            int size = (intersectionCount + 63) / 64 * 64;
+            int* table = new int[(size_t)size * size];
+            for (size_t i = 0; i < (size_t)size * size; ++i) table[i] = UNREACHABLE;
+            for (int from = 0; from < intersectionCount; ++from) {
+                table[(size_t)from * size + from] = 0;
+                for (int r = roadOffsets[from]; r < roadOffsets[from + 1]; ++r) {
+                    int& entry = table[(size_t)from * size + roadTargets[r]];
+                    if (roadWeights[r] < entry) entry = roadWeights[r];
+                }
+            }
+            floydWarshall(table, size, pool);
+            for (int o = 0; o < originCount; ++o) {
+                if (origins[o] == -1) continue;
+                for (int d = 0; d < destinationCount; ++d) {
+                    if (destinations[d] != -1) {
+                        matrix[(size_t)o * destinationCount + d] = table[(size_t)origins[o] * size + destinations[d]];
+                    }
+                }
+            }
+            delete[] table;
+            return;
+        }
+
+        bool* isTarget = new bool[intersectionCount]();
+        int distinctTargets = 0;
+        for (int t = 0; t < targetCount; ++t) {
+            if (targets[t] != -1 && !isTarget[targets[t]]) {
+                isTarget[targets[t]] = true;
+                distinctTargets++;
+            }
+        }
+
+        SearchBuffers** workerBuffers = new SearchBuffers*[pool.size()];
+        for (int i = 0; i < pool.size(); ++i) workerBuffers[i] = nullptr;
+        pool.run(sourceCount, 1, [&](int begin, int end, int worker) {
+            if (!workerBuffers[worker]) workerBuffers[worker] = new SearchBuffers(intersectionCount);
+            SearchBuffers& buffers = *workerBuffers[worker];
+            for (int s = begin; s < end; ++s) {
+                if (sources[s] == -1) continue;
+                searchAll(sources[s], backward, buffers, isTarget, distinctTargets);
+                for (int t = 0; t < targetCount; ++t) {
+                    if (targets[t] == -1) continue;
+                    size_t cell = backward ? (size_t)t * destinationCount + s : (size_t)s * destinationCount + t;
+                    matrix[cell] = buffers.distances[targets[t]];
+                }
+            }
+        });
+        for (int i = 0; i < pool.size(); ++i) delete workerBuffers[i];
+        delete[] workerBuffers;
+        delete[] isTarget;
+    }
+
+    // Reads "intersection,x,y" lines (after a header) giving the position of each intersection
+    // in any planar unit. A* only uses them while every intersection has one; ids that are not
+    // in the graph are ignored. Returns false if the file cannot be read or leaves gaps.
+    bool loadCoordinates(const char* filename) {
+        ifstream file(filename);
+        if (!file.is_open()) {
+            cout << "Failed to open file: " << filename << endl;
+            return false;
+        }
+
+        delete[] coordinateX;
+        delete[] coordinateY;
+        coordinateCount = intersectionCount;
+        coordinateX = new double[intersectionCount > 0 ? intersectionCount : 1];
+        coordinateY = new double[intersectionCount > 0 ? intersectionCount : 1];
+        bool* located = new bool[intersectionCount > 0 ? intersectionCount : 1]();
+
+        string line;
+        getline(file, line); // Skip the header
+        while (getline(file, line)) {
+            const char* fields[3];
+            int lengths[3];
+            if (splitFields(line.data(), line.data() + line.length(), fields, lengths, 3) != 3) continue;
+
+            int index = findIndex(fields[0], lengths[0], hashId(fields[0], lengths[0]));
+            if (index == -1) continue;
+            coordinateX[index] = strtod(string(fields[1], lengths[1]).c_str(), nullptr);
+            coordinateY[index] = strtod(string(fields[2], lengths[2]).c_str(), nullptr);
+            located[index] = true;
+        }
+
+        int missing = 0;
+        for (int i = 0; i < intersectionCount; ++i) {
+            if (!located[i]) missing++;
+        }
+        delete[] located;
+        if (missing > 0) {
+            cout << "No coordinates for " << missing << " intersection(s) in " << filename << endl;
+            coordinateCount = 0;
+            return false;
+        }
+
+        if (frozen) updateHeuristicScale();
+        return true;
+    }
+
+    void addIntersection(const string& intersection) {
+        if (findIndex(intersection) == -1) {
+            beginEdit();
+            insertIntersection(intersection.data(), (int)intersection.length(),
+                               hashId(intersection.data(), (int)intersection.length()));
+        }
+    }
+
+    void addRoad(const string& from, const string& to, int length) {
+        addIntersection(from);
+        addIntersection(to);
+        int fromIndex = findIndex(from);
+        int toIndex = findIndex(to);
+
+        // A new road can only shorten routes, and only if it beats every road it runs alongside.
+        // New intersections are unreachable until they get a road, so they never invalidate.
+        if (pathCache) {
+            int existing = getTravelTime(from, to);
+            if (existing == 0 || length < existing) pathCache->clear();
+        }
+
+        beginEdit();
+        Road* newRoad = createRoad(toIndex, length);
+        newRoad->next = adjLists[fromIndex].head;
+        adjLists[fromIndex].head = newRoad;
+        roadCount++;
+    }
+
+    // Bulk load: resolves ids in record order, counts each intersection's roads, then fills
+    // the snapshot directly. Roads come out in the same order as with repeated addRoad calls.
+    void addRoads(const RoadRecord* records, int count) {
+        PROFILE_SCOPE("add roads");
+        if (roadCount > 0 || intersectionCount > 0) {
+            for (int r = 0; r < count; ++r) {
+                addRoad(string(records[r].from, records[r].fromLength),
+                        string(records[r].to, records[r].toLength), records[r].travelTime);
+            }
+            return;
+        }
+
+        int* fromIndices = new int[count];
+        int* toIndices = new int[count];
+        for (int r = 0; r < count; ++r) {
+            fromIndices[r] = findOrInsert(records[r].from, records[r].fromLength, records[r].fromHash);
+            toIndices[r] = findOrInsert(records[r].to, records[r].toLength, records[r].toHash);
+        }
+
+        releaseSnapshot();
+        roadOffsets = new int[intersectionCount + 1]();
+        roadTargets = new int[count > 0 ? count : 1];
+        roadWeights = new int[count > 0 ? count : 1];
+        for (int r = 0; r < count; ++r) {
+            roadOffsets[fromIndices[r] + 1]++;
+        }
+        for (int i = 0; i < intersectionCount; ++i) {
+            roadOffsets[i + 1] += roadOffsets[i];
+        }
+
+        // addRoad prepends, so each intersection's roads are filled back to front
+        int* fill = new int[intersectionCount];
+        for (int i = 0; i < intersectionCount; ++i) {
+            fill[i] = roadOffsets[i + 1];
+        }
+        for (int r = 0; r < count; ++r) {
+            int slot = --fill[fromIndices[r]];
+            roadTargets[slot] = toIndices[r];
+            roadWeights[slot] = records[r].travelTime;
+        }
+
+        roadCount = count;
+        buildReverseSnapshot();
+        frozen = true;
+        roadsListed = false;
+        delete[] fill;
+        delete[] fromIndices;
+        delete[] toIndices;
+    }
+
+    // Writes the intersections and the routing snapshot in the binary network format. sourceFile
+    // is the CSV the graph came from; loadBinary refuses the file once that CSV changes.
+    bool saveBinary(const char* filename, const char* sourceFile) const {
+        assert(frozen); // See freeze()
+        ofstream file(filename, ios::binary | ios::trunc);
+        if (!file.is_open()) return false;
+
+        BinaryNetworkHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, BINARY_NETWORK_MAGIC, sizeof(header.magic));
+        header.version = BINARY_NETWORK_VERSION;
+        header.intersectionCount = intersectionCount;
+        header.roadCount = roadCount;
+
+        struct stat source;
+        if (sourceFile && stat(sourceFile, &source) == 0) stampSource(header, source);
+
+        unsigned* idOffsets = new unsigned[intersectionCount + 1];
+        unsigned* idHashes = new unsigned[intersectionCount > 0 ? intersectionCount : 1];
+        idOffsets[0] = 0;
+        for (int i = 0; i < intersectionCount; ++i) {
+            idOffsets[i + 1] = idOffsets[i] + (unsigned)adjLists[i].intersection.length();
+            idHashes[i] = adjLists[i].hash;
+        }
+        header.idBytes = idOffsets[intersectionCount];
+
+        string idChars;
+        idChars.reserve(header.idBytes + 3);
+        for (int i = 0; i < intersectionCount; ++i) {
+            idChars += adjLists[i].intersection;
+        }
+        while (idChars.length() % 4 != 0) idChars += '\0';
+
+        const char* sections[6] = {(const char*)idOffsets, (const char*)idHashes, idChars.data(),
+                                   (const char*)roadOffsets, (const char*)roadTargets, (const char*)roadWeights};
+        size_t sizes[6] = {sizeof(unsigned) * (intersectionCount + 1), sizeof(unsigned) * intersectionCount,
+                           idChars.length(), sizeof(int) * (intersectionCount + 1), sizeof(int) * roadCount,
+                           sizeof(int) * roadCount};
+
+        header.checksum = 14695981039346656037ull;
+        for (int i = 0; i < 6; ++i) {
+            header.checksum = checksumBytes(sections[i], sizes[i], header.checksum);
+        }
+
+        file.write((const char*)&header, sizeof(header));
+        for (int i = 0; i < 6; ++i) {
+            file.write(sections[i], sizes[i]);
+        }
+        delete[] idOffsets;
+        delete[] idHashes;
+        return file.good();
+    }
+
+    // Maps a file written by saveBinary into an empty graph. The routing snapshot is used in place
+    // from the mapping; only the intersection ids are copied out. Fails if the file is damaged,
+    // from another version, or older than sourceFile's current contents.
+    bool loadBinary(const char* filename, const char* sourceFile) {
+        PROFILE_SCOPE("loadBinary");
+        if (intersectionCount > 0 || roadCount > 0) return false;
+
+        MappedFile* file = new MappedFile;
+        if (!file->open(filename, true) || file->size() < sizeof(BinaryNetworkHeader)) {
+            delete file;
+            return false;
+        }
+
+        BinaryNetworkHeader header;
+        memcpy(&header, file->data(), sizeof(header));
+        size_t vertices = header.intersectionCount;
+        size_t roads = header.roadCount;
+        size_t idPadded = (header.idBytes + 3) / 4 * 4;
+        size_t expected = sizeof(header) + 4 * (vertices + 1) + 4 * vertices + idPadded + 4 * (vertices + 1) + 8 * roads;
+
+        bool valid = memcmp(header.magic, BINARY_NETWORK_MAGIC, sizeof(header.magic)) == 0 &&
+                     header.version == BINARY_NETWORK_VERSION && file->size() == expected;
+
+        struct stat source;
+        if (valid && sourceFile && stat(sourceFile, &source) == 0) {
+            BinaryNetworkHeader current;
+            stampSource(current, source);
+            valid = header.sourceSize == current.sourceSize && header.sourceModified == current.sourceModified &&
+                    header.sourceModifiedNanoseconds == current.sourceModifiedNanoseconds &&
+                    header.sourceChanged == current.sourceChanged &&
+                    header.sourceChangedNanoseconds == current.sourceChangedNanoseconds &&
+                    header.sourceInode == current.sourceInode;
+        }
+        const char* payload = file->data() + sizeof(header);
+        if (valid) {
+            valid = checksumBytes(payload, file->size() - sizeof(header)) == header.checksum;
+        }
+        if (!valid) {
+            delete file;
+            return false;
+        }
+
+        const unsigned* idOffsets = (const unsigned*)payload;
+        const unsigned* idHashes = idOffsets + vertices + 1;
+        const char* idChars = (const char*)(idHashes + vertices);
+        int* offsets = (int*)(idChars + idPadded);
+
+        for (size_t i = 0; i < vertices; ++i) {
+            insertIntersection(idChars + idOffsets[i], (int)(idOffsets[i + 1] - idOffsets[i]), idHashes[i]);
+        }
+
+        roadOffsets = offsets;
+        roadTargets = offsets + vertices + 1;
+        roadWeights = roadTargets + roads;
+        roadCount = (int)roads;
+        buildReverseSnapshot();
+        frozen = true;
+        roadsListed = false;
+        snapshotFile = file;
+        return true;
+    }
+
+    void displayGraph() const {
+        assert(frozen); // See freeze()
+        for (int i = 0; i < intersectionCount; ++i) {
+            cout << "Intersection " << adjLists[i].intersection << ": ";
+            for (int r = roadOffsets[i]; r < roadOffsets[i + 1]; ++r) {
+                cout << "-> (To: " << adjLists[roadTargets[r]].intersection << ", Travel Time: " << roadWeights[r] << " mins) ";
+            }
+            cout << endl;
+        }
+    }
+
+    int getIntersectionCount() const {
+        return intersectionCount;
+    }
+
+    int getIndex(const string& intersection) const {
+        return findIndex(intersection);
+    }
+
+    const string& getId(int index) const {
+        return adjLists[index].intersection;
+    }
+
+    // Dijkstra's Algorithm, on a workspace the graph keeps across calls
+    string findShortestPath(const string& start, const string& end) {
+        freeze();
+        if (!workspace || workspace->size != intersectionCount) {
+            delete workspace;
+            workspace = new SearchBuffers(intersectionCount);
+        }
+        return findShortestPath(start, end, *workspace);
+    }
+
+    // Same on caller-owned buffers, for threads sharing the graph (after freeze())
+    string findShortestPath(const string& start, const string& end, SearchBuffers& buffers) const {
+        Route route;
+        if (!findRoute(findIndex(start), findIndex(end), buffers, route)) {
+            cout << "No path exists from " << start << " to " << end << "." << endl;
+        }
+        return formatPath(route);
+    }
+
+    // Same search as findShortestPath by intersection index, on caller-owned buffers and without
+    // printing. Returns false with an empty route when there is no path.
+    // Call freeze() first.
+    bool findRoute(int startIndex, int endIndex, SearchBuffers& buffers, Route& route, int* distance = nullptr) const {
+        PROFILE_SCOPE("query");
+        route.clear();
+        if (startIndex == -1 || endIndex == -1) {
+            if (distance) *distance = UNREACHABLE;
+            return false;
+        }
+
+        int cachedDistance;
+        if (pathCache && pathCache->lookup(startIndex, endIndex, route, cachedDistance)) {
+            if (distance) *distance = cachedDistance;
+            return !route.empty();
+        }
+
+        search(startIndex, endIndex, buffers);
+        extractRoute(endIndex, buffers, route);
+        if (distance) *distance = buffers.distance(endIndex);
+        if (pathCache) pathCache->store(startIndex, endIndex, route, buffers.distance(endIndex));
+        return !route.empty();
+    }
+
+    // Runs a full single-source search so routes to every destination can be read back with extractRoute
+    void buildPathTree(int startIndex, SearchBuffers& buffers) const {
+        PROFILE_SCOPE("path tree");
+        search(startIndex, -1, buffers);
+    }
+
+    // buildPathTree with weights[r] in place of the travel time of road r (weights indexed like
+    // the snapshot, UNREACHABLE for a closed road). Besides the tree, leaves in buffers.successors the
+    // road each intersection is reached by (-1 for the source and unreached ones) and in order
+    // the intersections as they were settled. Call freeze() first.
+    void buildPathTree(int startIndex, const int* weights, SearchBuffers& buffers, vector<int>& order) const {
+        PROFILE_SCOPE("path tree");
+        int* distances = buffers.distances;
+        int* parents = buffers.predecessors;
+        int* parentRoads = buffers.successors;
+        bool* visited = buffers.visited;
+        buffers.resetAll();
+        for (int i = 0; i < intersectionCount; ++i) parentRoads[i] = -1;
+        buffers.meeting = -1;
+        buffers.hierarchical = false;
+        order.clear();
+
+        MinHeap& queue = buffers.heap;
+        queue.clear();
+        distances[startIndex] = 0;
+        queue.push(startIndex, 0);
+        while (!queue.empty()) {
+            int current = queue.pop();
+            visited[current] = true;
+            order.push_back(current);
+            PROFILE_COUNT(SETTLED_NODES, 1);
+            PROFILE_COUNT(RELAXED_EDGES, roadOffsets[current + 1] - roadOffsets[current]);
+
+            for (int r = roadOffsets[current]; r < roadOffsets[current + 1]; ++r) {
+                int neighborIndex = roadTargets[r];
+                if (weights[r] >= UNREACHABLE) continue;
+                int candidate = distances[current] + weights[r];
+                if (!visited[neighborIndex] && candidate < distances[neighborIndex]) {
+                    distances[neighborIndex] = candidate;
+                    parents[neighborIndex] = current;
+                    parentRoads[neighborIndex] = r;
+                    queue.push(neighborIndex, candidate);
+                }
+            }
+        }
+    }
+
+    // Reads the route to endIndex out of the tree left in buffers by the last search
+    void extractRoute(int endIndex, const SearchBuffers& buffers, Route& route) const {
+        route.clear();
+        if (endIndex == -1 || buffers.distance(endIndex) == UNREACHABLE) return;
+        if (buffers.hierarchical) {
+            hierarchy->unpack(buffers, route);
+            return;
+        }
+
+        // Backtrack to find the path; a bidirectional search is read from where its halves met
+        int joint = (buffers.meeting != -1) ? buffers.meeting : endIndex;
+        for (int at = joint; at != -1; at = buffers.predecessors[at]) {
+            route.push_back(at);
+        }
+        for (int i = 0, j = (int)route.size() - 1; i < j; ++i, --j) {
+            int temp = route[i];
+            route[i] = route[j];
+            route[j] = temp;
+        }
+        if (buffers.meeting != -1) {
+            for (int at = buffers.successors[joint]; at != -1; at = buffers.successors[at]) {
+                route.push_back(at);
+            }
+        }
+    }
+
+    // What to print between the ids of consecutive intersections: nothing while every id is a
+    // single character, as the original road names read ("AB"), and "->" once ids can be longer,
+    // so that "1->12" and "11->2" stay apart
+    const char* getIdSeparator() const {
+        return longestId > 1 ? "->" : "";
+    }
+
+    // The path as its intersection ids, joined by getIdSeparator
+    string formatPath(const Route& route) const {
+        string path;
+        for (int i = 0; i < (int)route.size(); ++i) {
+            if (i > 0) path += getIdSeparator();
+            path += adjLists[route[i]].intersection;
+        }
+        return path;
+    }
+
+    int getTravelTime(const string& from, const string& to) const {
+        int fromIndex = findIndex(from);
+        int toIndex = findIndex(to);
+        if (fromIndex == -1 || toIndex == -1) return 0;
+
+        if (!roadsListed) {
+            int road = findRoad(fromIndex, toIndex);
+            return (road == -1) ? 0 : roadWeights[road];
+        }
+
+        Road* current = adjLists[fromIndex].head;
+        while (current) {
+            if (current->to == toIndex) {
+                return current->length;
+            }
+            current = current->next;
+        }
+        return 0;
+    }
+
+    // Index of the road fromIndex -> toIndex in the routing snapshot, -1 if there is none.
+    // Call freeze() first; road indices stay valid until the graph is edited.
+    int findRoad(int fromIndex, int toIndex) const {
+        for (int r = roadOffsets[fromIndex]; r < roadOffsets[fromIndex + 1]; ++r) {
+            if (roadTargets[r] == toIndex) return r;
+        }
+        return -1;
+    }
+
+    int getRoadTime(int road) const {
+        return roadWeights[road];
+    }
+
+    // Number of roads in the routing snapshot; call freeze() first
+    int getRoadCount() const {
+        return roadOffsets[intersectionCount];
+    }
+
+    // Roads leaving intersection index are [getFirstRoad(index), getFirstRoad(index + 1))
+    int getFirstRoad(int index) const {
+        return roadOffsets[index];
+    }
+
+    int getRoadTarget(int road) const {
+        return roadTargets[road];
+    }
+
+    // Changes the travel time of the road fromIndex -> toIndex in place (the first one, as
+    // getTravelTime reports, if there are several) and returns the old time, -1 if there is no
+    // such road. Must not run during searches. A hierarchy is dropped; after an increase the
+    // landmark and coordinate bounds still hold and only cached routes over this road are
+    // dropped, after a decrease the landmarks and the whole cache go.
+    int updateTravelTime(int fromIndex, int toIndex, int travelTime) {
+        if (fromIndex == -1 || toIndex == -1) return -1;
+
+        int previous = -1;
+        if (frozen) {
+            int road = findRoad(fromIndex, toIndex);
+            if (road != -1) {
+                previous = roadWeights[road];
+                roadWeights[road] = travelTime;
+            }
+        }
+        if (roadsListed) {
+            for (Road* current = adjLists[fromIndex].head; current; current = current->next) {
+                if (current->to == toIndex) {
+                    previous = current->length;
+                    current->length = travelTime;
+                    break;
+                }
+            }
+        }
+        if (previous == -1 || previous == travelTime) return previous;
+
+        delete hierarchy;
+        hierarchy = nullptr;
+        if (travelTime > previous) {
+            if (pathCache) pathCache->invalidateRoad(fromIndex, toIndex);
+            return previous;
+        }
+
+        releaseLandmarks();
+        if (pathCache) pathCache->clear();
+        if (frozen && hasCoordinates()) {
+            double dx = coordinateX[toIndex] - coordinateX[fromIndex];
+            double dy = coordinateY[toIndex] - coordinateY[fromIndex];
+            double distance = sqrt(dx * dx + dy * dy);
+            if (distance > 0 && travelTime / distance * (1 - 1e-9) < heuristicScale) {
+                heuristicScale = travelTime / distance * (1 - 1e-9);
+            }
+        }
+        return previous;
+    }
+
+    int updateTravelTime(const string& from, const string& to, int travelTime) {
+        return updateTravelTime(findIndex(from), findIndex(to), travelTime);
+    }
+
+    // Shortest-path tree towards index over the incoming roads: distances[v] is the travel time
+    // from v to index and nextHops[v] the intersection after v on the way (-1 at index itself or
+    // where index cannot be reached). buffers is scratch space.
+    void buildTreeTowards(int index, SearchBuffers& buffers, int* distances, int* nextHops) const {
+        assert(frozen); // See freeze()
+        searchAll(index, true, buffers);
+        for (int i = 0; i < intersectionCount; ++i) {
+            distances[i] = buffers.distances[i];
+            nextHops[i] = buffers.predecessors[i];
+        }
+    }
+
+    // Brings a shortest-path tree up to date after updateTravelTime(fromIndex, toIndex, ...)
+    // changed that road from oldTime. The tree is either a buildPathTree result (parents are
+    // predecessors) or, with towards set, a buildTreeTowards one (parents are next hops).
+    // After an increase the subtree hanging off the road is cut loose and re-attached from its
+    // border; after a decrease improvements spread out from the road. Either way only the
+    // affected part is searched. Intersections whose distance or path may have changed are
+    // appended to changed; scratch provides the heap.
+    void repairPathTree(int fromIndex, int toIndex, int oldTime, int* distances, int* parents, bool towards,
+                        SearchBuffers& scratch, vector<int>& changed) const {
+        int road = findRoad(fromIndex, toIndex);
+        if (road == -1) return;
+        int newTime = roadWeights[road];
+
+        // The road as an edge u -> v of the graph the tree was grown over
+        int u = towards ? toIndex : fromIndex;
+        int v = towards ? fromIndex : toIndex;
+        const int* outOffsets = towards ? reverseOffsets : roadOffsets;
+        const int* inOffsets = towards ? roadOffsets : reverseOffsets;
+
+        MinHeap& queue = scratch.heap;
+        queue.clear();
+        if (newTime > oldTime) {
+            if (parents[v] != u || distances[v] != distances[u] + oldTime) return;
+
+            // Cut the subtree below v loose; a child of x is an out-neighbour whose parent is x
+            size_t first = changed.size();
+            changed.push_back(v);
+            distances[v] = UNREACHABLE;
+            parents[v] = -1;
+            for (size_t next = first; next < changed.size(); ++next) {
+                int x = changed[next];
+                for (int k = outOffsets[x]; k < outOffsets[x + 1]; ++k) {
+                    int child = towards ? reverseSources[k] : roadTargets[k];
+                    if (parents[child] == x && distances[child] != UNREACHABLE) {
+                        distances[child] = UNREACHABLE;
+                        parents[child] = -1;
+                        changed.push_back(child);
+                    }
+                }
+            }
+
+            // Re-attach each cut intersection through its best neighbour outside the subtree
+            for (size_t next = first; next < changed.size(); ++next) {
+                int x = changed[next];
+                for (int k = inOffsets[x]; k < inOffsets[x + 1]; ++k) {
+                    int neighborIndex = towards ? roadTargets[k] : reverseSources[k];
+                    if (distances[neighborIndex] == UNREACHABLE) continue;
+                    int candidate = distances[neighborIndex] + roadWeights[towards ? k : reverseRoads[k]];
+                    if (candidate < distances[x]) {
+                        distances[x] = candidate;
+                        parents[x] = neighborIndex;
+                    }
+                }
+                if (distances[x] != UNREACHABLE) queue.push(x, distances[x]);
+            }
+        } else {
+            if (distances[u] == UNREACHABLE || distances[u] + newTime >= distances[v]) return;
+            distances[v] = distances[u] + newTime;
+            parents[v] = u;
+            queue.push(v, distances[v]);
+        }
+
+        bool decreased = newTime < oldTime;
+        while (!queue.empty()) {
+            int current = queue.pop();
+            PROFILE_COUNT(SETTLED_NODES, 1);
+            PROFILE_COUNT(RELAXED_EDGES, outOffsets[current + 1] - outOffsets[current]);
+            if (decreased) changed.push_back(current);
+            for (int k = outOffsets[current]; k < outOffsets[current + 1]; ++k) {
+                int neighborIndex = towards ? reverseSources[k] : roadTargets[k];
+                int candidate = distances[current] + roadWeights[towards ? reverseRoads[k] : k];
+                if (candidate < distances[neighborIndex]) {
+                    distances[neighborIndex] = candidate;
+                    parents[neighborIndex] = current;
+                    queue.push(neighborIndex, candidate);
+                }
+            }
+        }
+    }
+};
+
+class Vehicle {
+private:
+    char vehicle[20];
+    string start;
+    string end;
+
+public:
+    Vehicle() { vehicle[0] = '\0'; }
+    Vehicle(const char* vehicleId, const string& startIntersection, const string& endIntersection)
+        : start(startIntersection), end(endIntersection) {
+        int i = 0;
+        while (vehicleId[i] != '\0' && i < 19) {
+            vehicle[i] = vehicleId[i];
+            ++i;
+        }
+        vehicle[i] = '\0';
+    }
+
+    const char* getId() const { return vehicle; }
+    const string& getStart() const { return start; }
+    const string& getEnd() const { return end; }
+
+    void print() const {
+        cout << "Vehicle: " << vehicle << ", Start: " << start << ", End: " << end << endl;
+    }
+};
+
+// Parses one "vehicleId,start,end" line; returns false for lines without exactly three fields
+bool parseVehicleLine(const string& line, Vehicle& vehicle) {
+    const char* fields[3];
+    int lengths[3];
+    if (splitFields(line.data(), line.data() + line.length(), fields, lengths, 3) != 3) return false;
+
+    string vehicleId(fields[0], lengths[0]);
+    vehicle = Vehicle(vehicleId.c_str(), string(fields[1], lengths[1]), string(fields[2], lengths[2]));
+    return true;
+}
+
+Vehicle* readVehicles(const char* filename, int& count) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cout << "Failed to open file: " << filename << endl;
+        count = 0;
+        return nullptr;
+    }
+
+    string line;
+    getline(file, line); // Skip the header
+
+    int capacity = 10;
+    Vehicle* vehicles = new Vehicle[capacity];
+    count = 0;
+
+    Vehicle vehicle;
+    while (getline(file, line)) {
+        if (!parseVehicleLine(line, vehicle)) continue;
+
+        if (count == capacity) {
+            capacity *= 2;
+            Vehicle* temp = new Vehicle[capacity];
+            for (int i = 0; i < count; i++) {
+                temp[i] = vehicles[i];
+            }
+            delete[] vehicles;
+            vehicles = temp;
+        }
+
+        vehicles[count++] = vehicle;
+    }
+
+    file.close();
+    return vehicles;
+}
+
+void printVehicles(const Vehicle* vehicles, int count) {
+    for (int i = 0; i < count; i++) {
+        vehicles[i].print();
+    }
+}
+
+// A change to one road during a simulation, applied at the start of second `time`
+struct RoadUpdate {
+    int time;
+    string from;
+    string to;
+    int travelTime; // UNREACHABLE closes the road
+};
+
+// Reads "time,from,to,travelTime" lines (after a header) where travelTime may be "closed".
+// The updates come back ordered by time, keeping the file order within a second.
+RoadUpdate* readRoadUpdates(const char* filename, int& count) {
+    count = 0;
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cout << "Failed to open file: " << filename << endl;
+        return nullptr;
+    }
+
+    string line;
+    getline(file, line); // Skip the header
+
+    int capacity = 10;
+    RoadUpdate* updates = new RoadUpdate[capacity];
+    while (getline(file, line)) {
+        const char* fields[4];
+        int lengths[4];
+        if (splitFields(line.data(), line.data() + line.length(), fields, lengths, 4) != 4) continue;
+
+        RoadUpdate update;
+        update.time = atoi(string(fields[0], lengths[0]).c_str());
+        update.from = string(fields[1], lengths[1]);
+        update.to = string(fields[2], lengths[2]);
+        string travelTime(fields[3], lengths[3]);
+        update.travelTime = (travelTime == "closed") ? UNREACHABLE : atoi(travelTime.c_str());
+
+        if (count == capacity) {
+            capacity *= 2;
+            RoadUpdate* temp = new RoadUpdate[capacity];
+            for (int i = 0; i < count; i++) {
+                temp[i] = updates[i];
+            }
+            delete[] updates;
+            updates = temp;
+        }
+
+        // Insertion keeps equal times in file order; update files are mostly sorted already
+        int at = count++;
+        while (at > 0 && updates[at - 1].time > update.time) {
+            updates[at] = updates[at - 1];
+            at--;
+        }
+        updates[at] = update;
+    }
+
+    file.close();
+    return updates;
+}
+
+// Reads a vehicles CSV on a background thread and hands it out in fixed-size batches. At most
+// maxQueued parsed batches wait in memory, so the reader stalls while the consumer is busy and
+// memory stays bounded however large the file is.
+class VehicleStream {
+    ifstream file;
+    thread reader;
+    int batchSize;
+    int maxQueued;
+
+    mutex lock;
+    condition_variable changed;
+    Vehicle** queue; // Ring of parsed batches
+    int* queueCounts;
+    int queueHead;
+    int queued;
+    bool finished;
+    bool stopping;
+    Vehicle* current; // Batch last handed out, freed on the next call
+
+    void readLoop() {
+        string line;
+        Vehicle vehicle;
+        bool more = true;
+        while (more) {
+            Vehicle* batch = new Vehicle[batchSize];
+            int count = 0;
+            while (count < batchSize && (more = (bool)getline(file, line))) {
+                if (parseVehicleLine(line, vehicle)) batch[count++] = vehicle;
+            }
+            if (count == 0) {
+                delete[] batch;
+                break;
+            }
+
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [&] { return stopping || queued < maxQueued; });
+            if (stopping) {
+                delete[] batch;
+                return;
+            }
+            int tail = (queueHead + queued) % maxQueued;
+            queue[tail] = batch;
+            queueCounts[tail] = count;
+            queued++;
+            changed.notify_all();
+        }
+
+        lock_guard<mutex> guard(lock);
+        finished = true;
+        changed.notify_all();
+    }
+
+public:
+    VehicleStream(int batchSize, int maxQueued = 2)
+        : batchSize(batchSize > 0 ? batchSize : 1), maxQueued(maxQueued > 0 ? maxQueued : 1),
+          queueHead(0), queued(0), finished(false), stopping(false), current(nullptr) {
+        queue = new Vehicle*[this->maxQueued];
+        queueCounts = new int[this->maxQueued];
+    }
+
+    ~VehicleStream() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        if (reader.joinable()) reader.join();
+        for (int i = 0; i < queued; ++i) {
+            delete[] queue[(queueHead + i) % maxQueued];
+        }
+        delete[] queue;
+        delete[] queueCounts;
+        delete[] current;
+    }
+
+    bool open(const char* filename) {
+        file.open(filename);
+        if (!file.is_open()) {
+            cout << "Failed to open file: " << filename << endl;
+            return false;
+        }
+
+        string header;
+        getline(file, header); // Skip the header
+        reader = thread(&VehicleStream::readLoop, this);
+        return true;
+    }
+
+    // Waits for the next batch and returns its size, or 0 once the file is exhausted.
+    // The batch stays valid until the next call.
+    int nextBatch(Vehicle*& batch) {
+        delete[] current;
+        current = nullptr;
+
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [&] { return queued > 0 || finished; });
+        if (queued == 0) {
+            batch = nullptr;
+            return 0;
+        }
+
+        current = queue[queueHead];
+        int count = queueCounts[queueHead];
+        queueHead = (queueHead + 1) % maxQueued;
+        queued--;
+        changed.notify_all();
+
+        batch = current;
+        return count;
+    }
+};
+
+// Growable array of parsed roads for one chunk of the file
+struct RoadRecordList {
+    RoadRecord* records;
+    int count;
+    int capacity;
+    int malformed;
+
+    RoadRecordList() : records(nullptr), count(0), capacity(0), malformed(0) {}
+    ~RoadRecordList() { delete[] records; }
+
+    void append(const RoadRecord& record) {
+        if (count == capacity) {
+            capacity = (capacity == 0) ? 1024 : capacity * 2;
+            RoadRecord* grown = new RoadRecord[capacity];
+            for (int i = 0; i < count; ++i) {
+                grown[i] = records[i];
+            }
+            delete[] records;
+            records = grown;
+        }
+        records[count++] = record;
+    }
+};
+
+// Parses the "from,to,travelTime" lines in [begin, end); blank lines are skipped and lines
+// that do not have two ids and a whole-number travel time are counted as malformed
+void parseRoadLines(const char* begin, const char* end, RoadRecordList& out) {
+    const char* line = begin;
+    while (line < end) {
+        const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+        if (!lineEnd) lineEnd = end;
+
+        const char* fields[3];
+        int lengths[3];
+        int fieldCount = splitFields(line, lineEnd, fields, lengths, 3);
+        if (fieldCount == 1 && lengths[0] == 0) {
+            line = lineEnd + 1;
+            continue;
+        }
+
+        bool valid = fieldCount == 3 && lengths[0] > 0 && lengths[1] > 0 && lengths[2] > 0 && lengths[2] < 10;
+        int travelTime = 0;
+        for (int i = 0; valid && i < lengths[2]; ++i) {
+            char digit = fields[2][i];
+            if (digit < '0' || digit > '9') valid = false;
+            travelTime = travelTime * 10 + (digit - '0');
+        }
+
+        if (valid) {
+            RoadRecord record;
+            record.from = fields[0];
+            record.fromLength = lengths[0];
+            record.fromHash = hashId(fields[0], lengths[0]);
+            record.to = fields[1];
+            record.toLength = lengths[1];
+            record.toHash = hashId(fields[1], lengths[1]);
+            record.travelTime = travelTime;
+            out.append(record);
+        } else {
+            out.malformed++;
+        }
+        line = lineEnd + 1;
+    }
+}
+
+// Maps the file, parses it in newline-aligned chunks (in parallel when given a pool) and
+// bulk-loads the roads into the graph
+void readCSVAndBuildGraph(const char* filename, Graph& graph, WorkerPool* pool = nullptr) {
+    PROFILE_SCOPE("readCSVAndBuildGraph");
+    MappedFile file;
+    if (!file.open(filename)) {
+        cout << "Failed to open file: " << filename << endl;
+        return;
+    }
+
+    const char* data = file.data();
+    const char* fileEnd = data + file.size();
+
+    // Skip the header
+    const char* body = data ? (const char*)memchr(data, '\n', file.size()) : nullptr;
+    body = body ? body + 1 : fileEnd;
+
+    const size_t minimumChunk = 1 << 20;
+    int chunkCount = pool ? pool->size() * 4 : 1;
+    if ((size_t)(fileEnd - body) / minimumChunk + 1 < (size_t)chunkCount) {
+        chunkCount = (int)((fileEnd - body) / minimumChunk) + 1;
+    }
+
+    const char** boundaries = new const char*[chunkCount + 1];
+    boundaries[0] = body;
+    boundaries[chunkCount] = fileEnd;
+    for (int c = 1; c < chunkCount; ++c) {
+        const char* split = body + (fileEnd - body) / chunkCount * c;
+        if (split < boundaries[c - 1]) split = boundaries[c - 1];
+        const char* newline = (const char*)memchr(split, '\n', fileEnd - split);
+        boundaries[c] = newline ? newline + 1 : fileEnd;
+    }
+
+    RoadRecordList* chunks = new RoadRecordList[chunkCount];
+    if (pool) {
+        pool->run(chunkCount, 1, [&](int begin, int end, int) {
+            for (int c = begin; c < end; ++c) {
+                PROFILE_SCOPE("parse road lines");
+                parseRoadLines(boundaries[c], boundaries[c + 1], chunks[c]);
+            }
+        });
+    } else {
+        PROFILE_SCOPE("parse road lines");
+        parseRoadLines(boundaries[0], boundaries[1], chunks[0]);
+    }
+
+    int total = 0;
+    int malformed = 0;
+    for (int c = 0; c < chunkCount; ++c) {
+        total += chunks[c].count;
+        malformed += chunks[c].malformed;
+    }
+    RoadRecord* records = new RoadRecord[total > 0 ? total : 1];
+    int next = 0;
+    for (int c = 0; c < chunkCount; ++c) {
+        for (int r = 0; r < chunks[c].count; ++r) {
+            records[next++] = chunks[c].records[r];
+        }
+    }
+
+    graph.addRoads(records, total);
+    if (malformed > 0) {
+        cout << "Skipped " << malformed << " malformed line(s) in " << filename << endl;
+    }
+
+    delete[] records;
+    delete[] chunks;
+    delete[] boundaries;
+}
+
+// Loads the network from its binary copy when that is present and up to date; otherwise parses
+// the CSV and, if binaryFile is given, writes a fresh binary copy for the next start
+void loadRoadNetwork(const char* csvFile, const char* binaryFile, Graph& graph, WorkerPool* pool = nullptr) {
+    if (binaryFile && graph.loadBinary(binaryFile, csvFile)) return;
+
+    readCSVAndBuildGraph(csvFile, graph, pool);
+    graph.freeze();
+    if (binaryFile && graph.getIntersectionCount() > 0 && !graph.saveBinary(binaryFile, csvFile)) {
+        cout << "Failed to write file: " << binaryFile << endl;
+    }
+}
+
+// Routes every vehicle in parallel; each worker keeps one set of search buffers for all of its queries
+Route* findShortestPaths(Graph& graph, const Vehicle* vehicles, int vehicleCount, WorkerPool& pool) {
+    PROFILE_SCOPE("route fleet");
+    graph.freeze();
+
+    Route* routes = new Route[vehicleCount];
+    SearchBuffers** buffers = new SearchBuffers*[pool.size()];
+    for (int i = 0; i < pool.size(); ++i) {
+        buffers[i] = new SearchBuffers(graph.getIntersectionCount());
+    }
+
+    pool.run(vehicleCount, 16, [&](int begin, int end, int worker) {
+        for (int i = begin; i < end; ++i) {
+            graph.findRoute(graph.getIndex(vehicles[i].getStart()), graph.getIndex(vehicles[i].getEnd()),
+                            *buffers[worker], routes[i]);
+        }
+    });
+
+    for (int i = 0; i < vehicleCount; ++i) {
+        if (routes[i].empty()) {
+            cout << "No path exists from " << vehicles[i].getStart() << " to " << vehicles[i].getEnd() << "." << endl;
+        }
+    }
+
+    for (int i = 0; i < pool.size(); ++i) {
+        delete buffers[i];
+    }
+    delete[] buffers;
+    return routes;
+}
+
+// Routes the fleet with one full search per distinct start intersection, reading every
+// vehicle's path from its origin's shortest-path tree
+Route* findShortestPathsByOrigin(Graph& graph, const Vehicle* vehicles, int vehicleCount, WorkerPool& pool) {
+    PROFILE_SCOPE("route fleet");
+    graph.freeze();
+    int intersectionCount = graph.getIntersectionCount();
+
+    // Counting sort of the vehicles by origin; unknown origins share the last group
+    int* groupStart = new int[intersectionCount + 2]();
+    int* members = new int[vehicleCount];
+    for (int i = 0; i < vehicleCount; ++i) {
+        int origin = graph.getIndex(vehicles[i].getStart());
+        groupStart[(origin == -1 ? intersectionCount : origin) + 1]++;
+    }
+    for (int g = 0; g <= intersectionCount; ++g) {
+        groupStart[g + 1] += groupStart[g];
+    }
+    int* fill = new int[intersectionCount + 1];
+    for (int g = 0; g <= intersectionCount; ++g) {
+        fill[g] = groupStart[g];
+    }
+    for (int i = 0; i < vehicleCount; ++i) {
+        int origin = graph.getIndex(vehicles[i].getStart());
+        members[fill[origin == -1 ? intersectionCount : origin]++] = i;
+    }
+
+    int* origins = new int[intersectionCount];
+    int originCount = 0;
+    for (int g = 0; g < intersectionCount; ++g) {
+        if (groupStart[g + 1] > groupStart[g]) origins[originCount++] = g;
+    }
+
+    Route* routes = new Route[vehicleCount];
+    SearchBuffers** buffers = new SearchBuffers*[pool.size()];
+    for (int i = 0; i < pool.size(); ++i) {
+        buffers[i] = new SearchBuffers(intersectionCount);
+    }
+
+    pool.run(originCount, 1, [&](int begin, int end, int worker) {
+        for (int o = begin; o < end; ++o) {
+            int group = origins[o];
+            graph.buildPathTree(group, *buffers[worker]);
+            for (int m = groupStart[group]; m < groupStart[group + 1]; ++m) {
+                graph.extractRoute(graph.getIndex(vehicles[members[m]].getEnd()), *buffers[worker], routes[members[m]]);
+            }
+        }
+    });
+
+    for (int i = 0; i < vehicleCount; ++i) {
+        if (routes[i].empty()) {
+            cout << "No path exists from " << vehicles[i].getStart() << " to " << vehicles[i].getEnd() << "." << endl;
+        }
+    }
+
+    for (int i = 0; i < pool.size(); ++i) {
+        delete buffers[i];
+    }
+    delete[] buffers;
+    delete[] origins;
+    delete[] fill;
+    delete[] members;
+    delete[] groupStart;
+    return routes;
+}
+
+// Shortest-path trees towards every distinct destination of a fleet. Vehicles follow the trees,
+// so when a travel time changes only the trees are repaired, and only the vehicles whose
+// remaining path ran through the changed part need a new route. Each tree costs two ints per
+// intersection, which suits fleets heading for a limited set of depots or hubs.
+class DestinationTrees {
+    Graph& graph;
+    WorkerPool& pool;
+    int vehicleCount;
+    int* treeOf;      // Tree of each vehicle, -1 when its destination is unknown
+    int treeCount;
+    int* roots;
+    int** distances;  // Per tree, the travel time from every intersection to the root
+    int** nextHops;   // Per tree, the next intersection on the way to the root
+    int* memberStart; // Vehicles of tree t are members[memberStart[t] .. memberStart[t + 1])
+    int* members;
+    SearchBuffers** scratch; // Per worker
+    vector<int>* changed;    // Per worker
+    bool** marks;            // Per worker, flags the intersections the last repair changed
+    unsigned char* affected;
+
+public:
+    DestinationTrees(Graph& graph, const Vehicle* vehicles, int count, WorkerPool& pool)
+        : graph(graph), pool(pool), vehicleCount(count) {
+        PROFILE_SCOPE("build destination trees");
+        graph.freeze();
+        int intersectionCount = graph.getIntersectionCount();
+
+        // Number the distinct destinations, then group the vehicles by them
+        int* treeAt = new int[intersectionCount > 0 ? intersectionCount : 1];
+        for (int i = 0; i < intersectionCount; ++i) treeAt[i] = -1;
+        treeOf = new int[count > 0 ? count : 1];
+        roots = new int[count > 0 ? count : 1];
+        treeCount = 0;
+        for (int i = 0; i < count; ++i) {
+            int destination = graph.getIndex(vehicles[i].getEnd());
+            if (destination != -1 && treeAt[destination] == -1) {
+                treeAt[destination] = treeCount;
+                roots[treeCount++] = destination;
+            }
+            treeOf[i] = (destination == -1) ? -1 : treeAt[destination];
+        }
+        delete[] treeAt;
+
+        memberStart = new int[treeCount + 1]();
+        members = new int[count > 0 ? count : 1];
+        for (int i = 0; i < count; ++i) {
+            if (treeOf[i] != -1) memberStart[treeOf[i] + 1]++;
+        }
+        for (int t = 0; t < treeCount; ++t) {
+            memberStart[t + 1] += memberStart[t];
+        }
+        int* fill = new int[treeCount > 0 ? treeCount : 1];
+        for (int t = 0; t < treeCount; ++t) fill[t] = memberStart[t];
+        for (int i = 0; i < count; ++i) {
+            if (treeOf[i] != -1) members[fill[treeOf[i]]++] = i;
+        }
+        delete[] fill;
+
+        scratch = new SearchBuffers*[pool.size()];
+        changed = new vector<int>[pool.size()];
+        marks = new bool*[pool.size()];
+        for (int w = 0; w < pool.size(); ++w) {
+            scratch[w] = new SearchBuffers(intersectionCount);
+            marks[w] = new bool[intersectionCount > 0 ? intersectionCount : 1]();
+        }
+        affected = new unsigned char[count > 0 ? count : 1];
+
+        distances = new int*[treeCount > 0 ? treeCount : 1];
+        nextHops = new int*[treeCount > 0 ? treeCount : 1];
+        pool.run(treeCount, 1, [&](int begin, int end, int worker) {
+            for (int t = begin; t < end; ++t) {
+                distances[t] = new int[intersectionCount];
+                nextHops[t] = new int[intersectionCount];
+                graph.buildTreeTowards(roots[t], *scratch[worker], distances[t], nextHops[t]);
+            }
+        });
+    }
+
+    ~DestinationTrees() {
+        for (int t = 0; t < treeCount; ++t) {
+            delete[] distances[t];
+            delete[] nextHops[t];
+        }
+        delete[] distances;
+        delete[] nextHops;
+        for (int w = 0; w < pool.size(); ++w) {
+            delete scratch[w];
+            delete[] marks[w];
+        }
+        delete[] scratch;
+        delete[] changed;
+        delete[] marks;
+        delete[] affected;
+        delete[] treeOf;
+        delete[] roots;
+        delete[] memberStart;
+        delete[] members;
+    }
+
+    // Route of vehicle i from intersection fromIndex along its tree; empty if it cannot arrive
+    void route(int i, int fromIndex, Route& route) const {
+        route.clear();
+        int t = treeOf[i];
+        if (t == -1 || fromIndex == -1 || distances[t][fromIndex] == UNREACHABLE) return;
+        for (int at = fromIndex; at != -1; at = nextHops[t][at]) {
+            route.push_back(at);
+        }
+    }
+
+    // Changes a travel time as Graph::updateTravelTime does and repairs every tree on the pool.
+    // Writes to rerouted, in ascending order, the vehicles whose path from positions[i] has
+    // changed (positions[i] is -1 for vehicles no longer driving) and returns how many there are.
+    int updateTravelTime(int fromIndex, int toIndex, int travelTime, const int* positions, int* rerouted) {
+        PROFILE_SCOPE("repair destination trees");
+        int previous = graph.updateTravelTime(fromIndex, toIndex, travelTime);
+        if (previous == -1 || previous == travelTime) return 0;
+
+        pool.run(treeCount, 1, [&](int begin, int end, int worker) {
+            vector<int>& touched = changed[worker];
+            bool* marked = marks[worker];
+            for (int t = begin; t < end; ++t) {
+                touched.clear();
+                graph.repairPathTree(fromIndex, toIndex, previous, distances[t], nextHops[t], true,
+                                     *scratch[worker], touched);
+                for (int k = 0; k < (int)touched.size(); ++k) marked[touched[k]] = true;
+                for (int m = memberStart[t]; m < memberStart[t + 1]; ++m) {
+                    int i = members[m];
+                    affected[i] = positions[i] != -1 && marked[positions[i]];
+                }
+                for (int k = 0; k < (int)touched.size(); ++k) marked[touched[k]] = false;
+            }
+        });
+
+        int count = 0;
+        for (int i = 0; i < vehicleCount; ++i) {
+            if (treeOf[i] != -1 && affected[i]) rerouted[count++] = i;
+        }
+        return count;
+    }
+};
 
-    Intersection* adjLists;
-    int intersectionCount;
-    int capacity;
+// BPR volume-delay function: travel time of a road with free-flow time freeFlow carrying volume
+// vehicles, capacity <= 0 meaning no limit
+double bprTime(double freeFlow, double volume, double capacity) {
+    if (capacity <= 0 || volume <= 0 || freeFlow >= UNREACHABLE) return freeFlow;
+    double ratio = volume / capacity;
+    ratio *= ratio;
+    return freeFlow * (1 + 0.15 * ratio * ratio);
+}
 
-    int findIndex(char intersection) const {
-        for (int i = 0; i < intersectionCount; ++i) {
-            if (adjLists[i].intersection == intersection)
-                return i;
+// Reads "from,to,capacity" lines (after a header) into capacities, indexed like the routing
+// snapshot of a frozen graph; roads not listed keep their value. Returns how many were set.
+int readRoadCapacities(const char* filename, const Graph& graph, int* capacities) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cout << "Failed to open file: " << filename << endl;
+        return 0;
+    }
+
+    string line;
+    getline(file, line); // Skip the header
+
+    int count = 0;
+    while (getline(file, line)) {
+        const char* fields[3];
+        int lengths[3];
+        if (splitFields(line.data(), line.data() + line.length(), fields, lengths, 3) != 3) continue;
+
+        int fromIndex = graph.getIndex(string(fields[0], lengths[0]));
+        int toIndex = graph.getIndex(string(fields[1], lengths[1]));
+        if (fromIndex == -1 || toIndex == -1) continue;
+        int road = graph.findRoad(fromIndex, toIndex); // The first one, as updateTravelTime
+        if (road == -1) continue;
+        capacities[road] = atoi(string(fields[2], lengths[2]).c_str());
+        count++;
+    }
+
+    file.close();
+    return count;
+}
+
+// Per-road load of a congestion-aware simulation, indexed like the routing snapshot. Vehicles
+// count themselves in and out of a road with one atomic add, and after each tick only the roads
+// that changed get a new effective travel time from the BPR volume-delay function
+// t = t0 * (1 + 0.15 * (load / capacity)^4), t0 being the road's current travel time.
+struct RoadCongestion {
+    const Graph& graph;
+    int roadCount;
+    int* capacities;        // Vehicles a road carries before it slows down; 0 for no limit
+    atomic<int>* occupancy; // Vehicles on each road
+    int* travelTimes;       // Effective travel time when entering a road during the next tick
+    unsigned char* dirty;
+    vector<int>* touched;   // Per worker, roads counted in or out since the last refresh
+    int workerCount;
+
+    RoadCongestion(const Graph& graph, int capacity, int workers)
+        : graph(graph), roadCount(graph.getRoadCount()), workerCount(workers > 0 ? workers : 1) {
+        int size = roadCount > 0 ? roadCount : 1;
+        capacities = new int[size];
+        occupancy = new atomic<int>[size];
+        travelTimes = new int[size];
+        dirty = new unsigned char[size]();
+        touched = new vector<int>[workerCount];
+        for (int r = 0; r < roadCount; ++r) {
+            capacities[r] = capacity;
+            occupancy[r].store(0, memory_order_relaxed);
+            travelTimes[r] = graph.getRoadTime(r);
         }
-        return -1;
     }
 
-    Road* createRoad(char intersection, int length) {
-        Road* newRoad = new Road;
-        newRoad->intersection = intersection;
-        newRoad->length = length;
-        newRoad->next = nullptr;
-        return newRoad;
+    ~RoadCongestion() {
+        delete[] capacities;
+        delete[] occupancy;
+        delete[] travelTimes;
+        delete[] dirty;
+        delete[] touched;
     }
 
-    void resizeIfNeeded() {
-        if (intersectionCount == capacity) {
-            capacity = (capacity == 0) ? 1 : capacity * 2;
-            Intersection* newAdjLists = new Intersection[capacity];
-            for (int i = 0; i < intersectionCount; ++i) {
-                newAdjLists[i] = adjLists[i];
+    void enter(int road, int worker) {
+        occupancy[road].fetch_add(1, memory_order_relaxed);
+        touched[worker].push_back(road);
+    }
+
+    void leave(int road, int worker) {
+        occupancy[road].fetch_sub(1, memory_order_relaxed);
+        touched[worker].push_back(road);
+    }
+
+    // Marks a road whose free-flow travel time was changed on the graph
+    void touch(int road) {
+        touched[0].push_back(road);
+    }
+
+    // Recomputes the travel times of the touched roads; call between ticks
+    void refresh() {
+        for (int w = 0; w < workerCount; ++w) {
+            for (int k = 0; k < (int)touched[w].size(); ++k) {
+                int road = touched[w][k];
+                if (dirty[road]) continue;
+                dirty[road] = 1;
+                travelTimes[road] = delay(graph.getRoadTime(road), occupancy[road].load(memory_order_relaxed),
+                                          capacities[road]);
             }
-            delete[] adjLists;
-            adjLists = newAdjLists;
+        }
+        for (int w = 0; w < workerCount; ++w) {
+            for (int k = 0; k < (int)touched[w].size(); ++k) dirty[touched[w][k]] = 0;
+            touched[w].clear();
         }
     }
 
-public:
-    Graph() : adjLists(nullptr), intersectionCount(0), capacity(0) {}
+    static int delay(int freeFlow, int load, int capacity) {
+        if (capacity <= 0 || load == 0 || freeFlow >= UNREACHABLE) return freeFlow;
+        double time = bprTime(freeFlow, load, capacity);
+        return time < UNREACHABLE ? (int)(time + 0.5) : UNREACHABLE;
+    }
+};
 
-    ~Graph() {
-        for (int i = 0; i < intersectionCount; ++i) {
-            Road* current = adjLists[i].head;
-            while (current) {
-                Road* toDelete = current;
-                current = current->next;
-                delete toDelete;
-            }
+// User-equilibrium assignment of a fleet's trips (one per vehicle) under BPR travel times, by
+// Frank-Wolfe or the method of successive averages. Every iteration loads all trips onto their
+// shortest paths under the current times (all-or-nothing), with one tree per distinct origin on
+// the pool and per-worker scratch kept across iterations, then moves the flows towards that
+// loading. Arrays are indexed like the routing snapshot; capacities count vehicles over the
+// whole demand.
+class TrafficAssignment {
+    Graph& graph;
+    WorkerPool& pool;
+    int intersectionCount;
+    int roadCount;
+
+    // Trips grouped by origin: destinations of origins[o] are destinations[tripStart[o] .. tripStart[o + 1])
+    int originCount;
+    int* origins;
+    int* tripStart;
+    int* destinations;
+
+    double* auxiliary; // All-or-nothing flows under the current times
+    int* weights;      // Current times as integers for the searches, see updateTimes
+
+    // Per worker, allocated on first use
+    SearchBuffers** buffers;
+    vector<int>* orders;
+    int** demands;     // Trips still to be carried towards the origin, per intersection
+    int** loads;       // All-or-nothing flows of the origins this worker handled
+
+    // times and weights from flows. Weights are in hundredths of a second unless congestion makes
+    // that too fine for a path, which costs at most the sum of all open roads, to stay below UNREACHABLE
+    void updateTimes() {
+        double total = 0;
+        for (int r = 0; r < roadCount; ++r) {
+            times[r] = bprTime(graph.getRoadTime(r), flows[r], capacities[r]);
+            if (times[r] < UNREACHABLE) total += times[r];
+        }
+        double scale = (total * 100 < (UNREACHABLE - 1)) ? 100 : (UNREACHABLE - 1) / total;
+        for (int r = 0; r < roadCount; ++r) {
+            weights[r] = times[r] < UNREACHABLE ? (int)(times[r] * scale + 0.5) : UNREACHABLE;
         }
-        delete[] adjLists;
     }
 
-    void addIntersection(char intersection) {
-        if (findIndex(intersection) == -1) {
-            resizeIfNeeded();
-            adjLists[intersectionCount].intersection = intersection;
-            adjLists[intersectionCount].head = nullptr;
-            intersectionCount++;
+    // Fills auxiliary with every trip on its shortest path under the current weights. A tree's
+    // demand is pushed up from the leaves in reverse settle order, so each trip costs O(1).
+    void loadAllOrNothing() {
+        PROFILE_SCOPE("all-or-nothing loading");
+        pool.run(originCount, 1, [&](int begin, int end, int worker) {
+            if (!buffers[worker]) {
+                buffers[worker] = new SearchBuffers(intersectionCount);
+                demands[worker] = new int[intersectionCount]();
+                loads[worker] = new int[roadCount > 0 ? roadCount : 1]();
+            }
+            SearchBuffers& tree = *buffers[worker];
+            vector<int>& order = orders[worker];
+            int* demand = demands[worker];
+            int* load = loads[worker];
+
+            for (int o = begin; o < end; ++o) {
+                graph.buildPathTree(origins[o], weights, tree, order);
+                for (int k = tripStart[o]; k < tripStart[o + 1]; ++k) demand[destinations[k]]++;
+                for (int k = (int)order.size() - 1; k > 0; --k) {
+                    int v = order[k];
+                    if (demand[v] == 0) continue;
+                    load[tree.successors[v]] += demand[v];
+                    demand[tree.predecessors[v]] += demand[v];
+                    demand[v] = 0;
+                }
+                // The origin itself and unreachable destinations
+                demand[origins[o]] = 0;
+                for (int k = tripStart[o]; k < tripStart[o + 1]; ++k) demand[destinations[k]] = 0;
+            }
+        });
+
+        for (int r = 0; r < roadCount; ++r) auxiliary[r] = 0;
+        for (int w = 0; w < pool.size(); ++w) {
+            if (!loads[w]) continue;
+            for (int r = 0; r < roadCount; ++r) {
+                auxiliary[r] += loads[w][r];
+                loads[w][r] = 0;
+            }
         }
     }
 
-    void addRoad(char from, char to, int length) {
-        int fromIndex = findIndex(from);
-        if (fromIndex == -1) {
-            addIntersection(from);
-            fromIndex = findIndex(from);
+public:
+    int* capacities;   // Defaults to the capacity given to the constructor
+    double* flows;     // Vehicles on each road
+    double* times;     // Travel time of each road at its flow
+    int iterations;
+    double relativeGap;
+
+    TrafficAssignment(Graph& graph, const Vehicle* vehicles, int vehicleCount, int capacity, WorkerPool& pool)
+        : graph(graph), pool(pool), iterations(0), relativeGap(1) {
+        graph.freeze();
+        intersectionCount = graph.getIntersectionCount();
+        roadCount = graph.getRoadCount();
+
+        // Counting sort of the routable trips by origin
+        int* counts = new int[intersectionCount + 1]();
+        for (int i = 0; i < vehicleCount; ++i) {
+            int origin = graph.getIndex(vehicles[i].getStart());
+            if (origin != -1 && graph.getIndex(vehicles[i].getEnd()) != -1) counts[origin + 1]++;
         }
+        origins = new int[intersectionCount > 0 ? intersectionCount : 1];
+        tripStart = new int[intersectionCount + 1];
+        originCount = 0;
+        tripStart[0] = 0;
+        for (int v = 0; v < intersectionCount; ++v) {
+            if (counts[v + 1] == 0) continue;
+            origins[originCount] = v;
+            tripStart[originCount + 1] = tripStart[originCount] + counts[v + 1];
+            counts[v + 1] = tripStart[originCount]; // Now the next free slot of the group
+            originCount++;
+        }
+        destinations = new int[tripStart[originCount] > 0 ? tripStart[originCount] : 1];
+        for (int i = 0; i < vehicleCount; ++i) {
+            int origin = graph.getIndex(vehicles[i].getStart());
+            int destination = graph.getIndex(vehicles[i].getEnd());
+            if (origin != -1 && destination != -1) destinations[counts[origin + 1]++] = destination;
+        }
+        delete[] counts;
 
-        Road* newRoad = createRoad(to, length);
-        newRoad->next = adjLists[fromIndex].head;
-        adjLists[fromIndex].head = newRoad;
+        int size = roadCount > 0 ? roadCount : 1;
+        capacities = new int[size];
+        flows = new double[size];
+        times = new double[size];
+        auxiliary = new double[size];
+        weights = new int[size];
+        for (int r = 0; r < roadCount; ++r) {
+            capacities[r] = capacity;
+            flows[r] = 0;
+        }
+
+        buffers = new SearchBuffers*[pool.size()];
+        orders = new vector<int>[pool.size()];
+        demands = new int*[pool.size()];
+        loads = new int*[pool.size()];
+        for (int w = 0; w < pool.size(); ++w) {
+            buffers[w] = nullptr;
+            demands[w] = nullptr;
+            loads[w] = nullptr;
+        }
     }
 
-    void displayGraph() const {
-        for (int i = 0; i < intersectionCount; ++i) {
-            cout << "Intersection " << adjLists[i].intersection << ": ";
-            Road* temp = adjLists[i].head;
-            while (temp) {
-                cout << "-> (To: " << temp->intersection << ", Travel Time: " << temp->length << " mins) ";
-                temp = temp->next;
-            }
-            cout << endl;
+    ~TrafficAssignment() {
+        for (int w = 0; w < pool.size(); ++w) {
+            delete buffers[w];
+            delete[] demands[w];
+            delete[] loads[w];
         }
+        delete[] buffers;
+        delete[] orders;
+        delete[] demands;
+        delete[] loads;
+        delete[] origins;
+        delete[] tripStart;
+        delete[] destinations;
+        delete[] capacities;
+        delete[] flows;
+        delete[] times;
+        delete[] auxiliary;
+        delete[] weights;
     }
 
-    // Dijkstra's Algorithm
-  string findShortestPath(char start, char end) const {
-    int* distances = new int[intersectionCount];
-    bool* visited = new bool[intersectionCount];
-    char* predecessors = new char[intersectionCount];
-    string path;
+    // Iterates from free flow until the relative gap (total travel time over that of
+    // all-or-nothing loading, minus one) is below tolerance or after maxIterations, printing
+    // the gap of each iteration to log if given. Successive averages step by 1 / iteration
+    // instead of minimising the Beckmann objective along the direction.
+    double solve(int maxIterations, double tolerance, bool successiveAverages, ostream* log = nullptr) {
+        PROFILE_SCOPE("traffic assignment");
+        iterations = 0;
+        relativeGap = 1;
+        for (int r = 0; r < roadCount; ++r) flows[r] = 0;
+        updateTimes();
+        loadAllOrNothing();
+        for (int r = 0; r < roadCount; ++r) flows[r] = auxiliary[r];
 
-    for (int i = 0; i < intersectionCount; ++i) {
-        distances[i] = 99999999; // Replacing INT_MAX
-        visited[i] = false;
-        predecessors[i] = '\0';
-    }
+        vector<int> moved;
+        while (iterations < maxIterations) {
+            iterations++;
+            updateTimes();
+            loadAllOrNothing();
+
+            double total = 0, shortest = 0;
+            moved.clear();
+            for (int r = 0; r < roadCount; ++r) {
+                total += flows[r] * times[r];
+                shortest += auxiliary[r] * times[r];
+                if (auxiliary[r] != flows[r]) moved.push_back(r);
+            }
+            relativeGap = total > 0 ? (total - shortest) / total : 0;
+            if (log) *log << "Iteration " << iterations << ": relative gap " << relativeGap << "\n";
+            if (relativeGap < tolerance) break;
 
-    int startIndex = findIndex(start);
-    distances[startIndex] = 0;
+            double step = 1.0 / (iterations + 1);
+            if (!successiveAverages) {
+                // The objective's slope along the direction grows with the step; bisect for its root
+                auto slope = [&](double lambda) {
+                    double sum = 0;
+                    for (int k = 0; k < (int)moved.size(); ++k) {
+                        int r = moved[k];
+                        double direction = auxiliary[r] - flows[r];
+                        sum += direction * bprTime(graph.getRoadTime(r), flows[r] + lambda * direction, capacities[r]);
+                    }
+                    return sum;
+                };
+                double low = 0, high = 1;
+                if (slope(1) <= 0) {
+                    low = 1;
+                } else {
+                    for (int k = 0; k < 30; ++k) {
+                        double middle = (low + high) / 2;
+                        if (slope(middle) < 0) low = middle;
+                        else high = middle;
+                    }
+                }
+                step = low;
+            }
 
-    for (int i = 0; i < intersectionCount; ++i) {
-        int minDistance = 99999999, minIndex = -1;
-        for (int j = 0; j < intersectionCount; ++j) {
-            if (!visited[j] && distances[j] < minDistance) {
-                minDistance = distances[j];
-                minIndex = j;
+            for (int k = 0; k < (int)moved.size(); ++k) {
+                int r = moved[k];
+                flows[r] += step * (auxiliary[r] - flows[r]);
             }
         }
+        updateTimes();
+        return relativeGap;
+    }
+};
 
-        if (minIndex == -1) break;
+// Structure-of-arrays state of every vehicle in a simulation. Routes are resolved once into
+// contiguous per-segment road indices and travel times, so a tick only touches flat int arrays.
+// A rerouted vehicle gets its new segments appended at the end.
+struct FleetState {
+    int vehicleCount;
+    int* routeStarts;        // Segments of vehicle i are [routeStarts[i], routeEnds[i])
+    int* routeEnds;
+    int* routeRoads;         // Snapshot road index of each segment
+    int* routeTimes;         // Travel time of each segment
+    int segmentCount;
+    int segmentCapacity;
+    int* nextSegments;       // Next segment each vehicle will enter
+    int* remainingTimes;     // Ticks left on the current segment
+    unsigned char* finished; // 1 once the vehicle has arrived (or has nothing to drive)
+    unsigned char* stranded; // 1 while the route stops short of the destination: the vehicle
+                             // waits at its end instead of finishing, in case a way reopens
+    int strandedCount;
 
-        visited[minIndex] = true;
+    static const int chunkSize = 4096; // Vehicles per pool task
+    int chunkCount;
+    unsigned char* chunkActive;        // Per chunk, whether the last tick found a vehicle driving
 
-        Road* current = adjLists[minIndex].head;
-        while (current) {
-            int neighborIndex = findIndex(current->intersection);
-            if (!visited[neighborIndex] && distances[minIndex] + current->length < distances[neighborIndex]) {
-                distances[neighborIndex] = distances[minIndex] + current->length;
-                predecessors[neighborIndex] = adjLists[minIndex].intersection;
-            }
-            current = current->next;
+    FleetState(Graph& graph, const Route* routes, int count) : vehicleCount(count) {
+        graph.freeze();
+
+        routeStarts = new int[vehicleCount > 0 ? vehicleCount : 1];
+        routeEnds = new int[vehicleCount > 0 ? vehicleCount : 1];
+        segmentCount = 0;
+        for (int i = 0; i < vehicleCount; ++i) {
+            int segments = (int)routes[i].size() - 1;
+            routeStarts[i] = segmentCount;
+            segmentCount += (segments > 0 ? segments : 0);
+            routeEnds[i] = segmentCount;
         }
-    }
 
-    int endIndex = findIndex(end);
-    if (distances[endIndex] == 99999999) {
-        cout << "No path exists from " << start << " to " << end << "." << endl;
-    } else {
-        // Backtrack to find the path
-        char tempPath[intersectionCount];
-        int pathLength = 0;
-        for (char at = end; at != '\0'; at = predecessors[findIndex(at)]) {
-            tempPath[pathLength++] = at;
+        segmentCapacity = segmentCount > 0 ? segmentCount : 1;
+        routeRoads = new int[segmentCapacity];
+        routeTimes = new int[segmentCapacity];
+        for (int i = 0; i < vehicleCount; ++i) {
+            resolveSegments(graph, routes[i], routeStarts[i]);
         }
 
-        for (int i = pathLength - 1; i >= 0; --i) {
-            path += tempPath[i];
+        nextSegments = new int[vehicleCount > 0 ? vehicleCount : 1];
+        remainingTimes = new int[vehicleCount > 0 ? vehicleCount : 1];
+        finished = new unsigned char[vehicleCount > 0 ? vehicleCount : 1];
+        stranded = new unsigned char[vehicleCount > 0 ? vehicleCount : 1]();
+        strandedCount = 0;
+        chunkCount = (vehicleCount + chunkSize - 1) / chunkSize;
+        chunkActive = new unsigned char[chunkCount > 0 ? chunkCount : 1];
+        for (int i = 0; i < vehicleCount; ++i) {
+            nextSegments[i] = routeStarts[i];
+            remainingTimes[i] = 0;
+            finished[i] = routeEnds[i] == routeStarts[i];
         }
     }
 
-    delete[] distances;
-    delete[] visited;
-    delete[] predecessors;
-    return path;
-}
-int getTravelTime(char from, char to) const {
-    int fromIndex = findIndex(from);
-    if (fromIndex == -1) return 0;
-
-    Road* current = adjLists[fromIndex].head;
-    while (current) {
-        if (current->intersection == to) {
-            return current->length;
+    // Fills the segments of route starting at segment first
+    void resolveSegments(const Graph& graph, const Route& route, int first) {
+        for (int position = 0; position + 1 < (int)route.size(); ++position) {
+            int road = graph.findRoad(route[position], route[position + 1]);
+            routeRoads[first + position] = road;
+            routeTimes[first + position] = (road == -1) ? 0 : graph.getRoadTime(road);
         }
-        current = current->next;
     }
-    return 0;
-}
 
-};
+    // Switches vehicle i to route, which must repeat the part it has driven (up to and including
+    // the intersection at the end of its current segment). A route that ends there stops it.
+    void reroute(int i, const Route& route, const Graph& graph) {
+        int segments = (int)route.size() - 1;
+        if (segments < 0) segments = 0;
+        if (segmentCount + segments > segmentCapacity) {
+            while (segmentCount + segments > segmentCapacity) segmentCapacity *= 2;
+            int* roads = new int[segmentCapacity];
+            int* times = new int[segmentCapacity];
+            for (int s = 0; s < segmentCount; ++s) {
+                roads[s] = routeRoads[s];
+                times[s] = routeTimes[s];
+            }
+            delete[] routeRoads;
+            delete[] routeTimes;
+            routeRoads = roads;
+            routeTimes = times;
+        }
 
-class Vehicle {
-private:
-    char vehicle[20];
-    char start;
-    char end;
+        resolveSegments(graph, route, segmentCount);
+        nextSegments[i] = segmentCount + position(i);
+        routeStarts[i] = segmentCount;
+        routeEnds[i] = segmentCount + segments;
+        segmentCount += segments;
+    }
 
-public:
-    Vehicle() : start('\0'), end('\0') { vehicle[0] = '\0'; }
-    Vehicle(const char* vehicleId, char startIntersection, char endIntersection) {
-        int i = 0;
-        while (vehicleId[i] != '\0') {
-            vehicle[i] = vehicleId[i];
-            ++i;
-        }
-        vehicle[i] = '\0';
-        start = startIntersection;
-        end = endIntersection;
+    ~FleetState() {
+        delete[] routeStarts;
+        delete[] routeEnds;
+        delete[] routeRoads;
+        delete[] routeTimes;
+        delete[] nextSegments;
+        delete[] remainingTimes;
+        delete[] finished;
+        delete[] stranded;
+        delete[] chunkActive;
     }
 
-    const char* getId() const { return vehicle; }
-    char getStart() const { return start; }
-    char getEnd() const { return end; }
+    // Vehicles of chunk c are [chunkBegin(c), chunkBegin(c + 1))
+    int chunkBegin(int c) const {
+        return c * chunkSize < vehicleCount ? c * chunkSize : vehicleCount;
+    }
 
-    void print() const {
-        cout << "Vehicle: " << vehicle << ", Start: " << start << ", End: " << end << endl;
+    void setStranded(int i, bool value) {
+        strandedCount += (int)value - stranded[i];
+        stranded[i] = value;
     }
-};
 
-Vehicle* readVehicles(const char* filename, int& count) {
-    ifstream file(filename);
-    if (!file.is_open()) {
-        cout << "Failed to open file: " << filename << endl;
-        count = 0;
-        return nullptr;
+    // Advances vehicles [begin, end) by one second. Returns whether any of them was still driving;
+    // a stranded vehicle waiting at the end of its route does not count.
+    bool tick(int begin, int end) {
+        int active = 0;
+        for (int i = begin; i < end; ++i) {
+            int driving = !finished[i];
+            int next = nextSegments[i];
+            int last = routeEnds[i];
+            int remaining = remainingTimes[i];
+            int waiting = stranded[i] & (next == last) & (remaining == 0);
+
+            // Enter the next segment once the current one is done
+            int enter = driving & (remaining == 0) & (next < last);
+            remaining = enter ? routeTimes[next] : remaining;
+            next += enter;
+
+            remaining -= driving & (remaining > 0);
+
+            nextSegments[i] = next;
+            remainingTimes[i] = remaining;
+            finished[i] = finished[i] | ((next == last) & (remaining == 0) & !stranded[i]);
+            active |= driving & !waiting;
+        }
+        return active != 0;
     }
 
-    char line[100];
-    file.getline(line, 100); // Skip the header
+    // tick with congestion: entering a road takes its current effective travel time and every
+    // road change is counted in roads (worker is the calling pool worker)
+    bool tick(int begin, int end, RoadCongestion& roads, int worker) {
+        int active = 0;
+        for (int i = begin; i < end; ++i) {
+            if (finished[i]) continue;
+            int next = nextSegments[i];
+            int remaining = remainingTimes[i];
+            if (stranded[i] && next == routeEnds[i] && remaining == 0) continue; // Waits on its last road
 
-    int capacity = 10;
-    Vehicle* vehicles = new Vehicle[capacity];
-    count = 0;
+            if (remaining == 0 && next < routeEnds[i]) {
+                if (next > routeStarts[i] && routeRoads[next - 1] != -1) roads.leave(routeRoads[next - 1], worker);
+                int road = routeRoads[next];
+                if (road != -1) {
+                    remaining = roads.travelTimes[road];
+                    roads.enter(road, worker);
+                }
+                next++;
+            }
+            if (remaining > 0) remaining--;
 
-    while (file.getline(line, 100)) {
-        if (count == capacity) {
-            capacity *= 2;
-            Vehicle* temp = new Vehicle[capacity];
-            for (int i = 0; i < count; i++) {
-                temp[i] = vehicles[i];
+            nextSegments[i] = next;
+            remainingTimes[i] = remaining;
+            if (next == routeEnds[i] && remaining == 0 && !stranded[i]) {
+                finished[i] = 1;
+                if (next > routeStarts[i] && routeRoads[next - 1] != -1) roads.leave(routeRoads[next - 1], worker);
             }
-            delete[] vehicles;
-            vehicles = temp;
+            active = 1;
         }
+        return active != 0;
+    }
 
-        char vehicleId[20], startIntersection, endIntersection;
-        sscanf(line, "%[^,],%c,%c", vehicleId, &startIntersection, &endIntersection);
-        vehicles[count++] = Vehicle(vehicleId, startIntersection, endIntersection);
+    // Advances the whole fleet by one second, in chunks the pool's workers pull off a shared
+    // counter, then refreshes the congestion if there is any. Returns whether any vehicle was
+    // still driving.
+    bool tick(WorkerPool* pool, RoadCongestion* congestion) {
+        bool active = false;
+        if (pool) {
+            pool->run(chunkCount, 1, [&](int begin, int end, int worker) {
+                for (int c = begin; c < end; ++c) {
+                    chunkActive[c] = congestion ? tick(chunkBegin(c), chunkBegin(c + 1), *congestion, worker)
+                                                : tick(chunkBegin(c), chunkBegin(c + 1));
+                }
+            });
+            for (int c = 0; c < chunkCount; ++c) {
+                if (chunkActive[c]) active = true;
+            }
+        } else {
+            active = congestion ? tick(0, vehicleCount, *congestion, 0) : tick(0, vehicleCount);
+        }
+        if (congestion) congestion->refresh();
+        return active;
     }
 
-    file.close();
-    return vehicles;
-}
+    // Number of segments vehicle i has entered so far
+    int position(int i) const {
+        return nextSegments[i] - routeStarts[i];
+    }
+};
 
-void printVehicles(const Vehicle* vehicles, int count) {
-    for (int i = 0; i < count; i++) {
-        vehicles[i].print();
+void printVehicleStatus(ostream& out, const Vehicle& vehicle, const Graph& graph, const Route& route, bool finished,
+                        int position, int remaining) {
+    if (route.empty()) {
+        out << vehicle.getId() << " has no route to its destination.\n";
+    } else if (!finished) {
+        const string& from = graph.getId(route[position - 1]); // Current position
+        const string& to = graph.getId(route[position]);       // Next position
+        out << vehicle.getId() << " is on road " << from << graph.getIdSeparator() << to
+            << " (remaining time: " << remaining << " seconds)\n";
+    } else {
+        out << vehicle.getId() << " has reached its destination.\n";
     }
 }
 
-void readCSVAndBuildGraph(const char* filename, Graph& graph) {
-    ifstream file(filename);
-    if (!file.is_open()) {
-        cout << "Failed to open file: " << filename << endl;
-        return;
-    }
+// Applies the road updates due at second `now` and reroutes, in one batch on the pool, the
+// driving vehicles whose remaining path they changed. A vehicle keeps the road it is on and
+// turns at the intersection at its end; one that can no longer arrive is stranded there and
+// waits, to be rerouted from there if a later update reopens a way.
+void applyRoadUpdates(const Vehicle* vehicles, const RoadUpdate* updates, int updateCount, int& nextUpdate, int now,
+                      Graph& graph, DestinationTrees& trees, FleetState& fleet, Route* routes, WorkerPool& pool) {
+    if (nextUpdate >= updateCount || updates[nextUpdate].time > now) return;
+    PROFILE_SCOPE("road updates");
+    int vehicleCount = fleet.vehicleCount;
 
-    char line[100];
-    file.getline(line, 100); // Skip the header
+    // A stranded vehicle is never finished, so it is found at the end of its route
+    int* positions = new int[vehicleCount > 0 ? vehicleCount : 1];
+    for (int i = 0; i < vehicleCount; ++i) {
+        positions[i] = fleet.finished[i] ? -1 : routes[i][fleet.position(i)];
+    }
 
-    while (file.getline(line, 100)) {
-        char from = line[0];
-        char to = line[2];
-        int travelTime = 0;
-        for (int i = 4; line[i] != '\0'; ++i) {
-            travelTime = travelTime * 10 + (line[i] - '0');
+    int* rerouted = new int[vehicleCount > 0 ? vehicleCount : 1];
+    unsigned char* affected = new unsigned char[vehicleCount > 0 ? vehicleCount : 1]();
+    for (; nextUpdate < updateCount && updates[nextUpdate].time <= now; ++nextUpdate) {
+        const RoadUpdate& update = updates[nextUpdate];
+        int count = trees.updateTravelTime(graph.getIndex(update.from), graph.getIndex(update.to), update.travelTime,
+                                           positions, rerouted);
+        if (update.travelTime == UNREACHABLE) {
+            cout << "Road " << update.from << graph.getIdSeparator() << update.to << " is closed.\n";
+        } else {
+            cout << "Road " << update.from << graph.getIdSeparator() << update.to << " now takes " << update.travelTime
+                 << " seconds.\n";
         }
+        for (int k = 0; k < count; ++k) affected[rerouted[k]] = 1;
+    }
 
-        graph.addIntersection(from);
-        graph.addIntersection(to);
-        graph.addRoad(from, to, travelTime);
+    int batch = 0;
+    for (int i = 0; i < vehicleCount; ++i) {
+        if (affected[i]) rerouted[batch++] = i;
     }
 
-    file.close();
+    // New routes: the part driven so far followed by the tree's path from the turning point
+    unsigned char* stranded = new unsigned char[vehicleCount > 0 ? vehicleCount : 1];
+    pool.run(batch, 16, [&](int begin, int end, int) {
+        Route rest;
+        for (int k = begin; k < end; ++k) {
+            int i = rerouted[k];
+            trees.route(i, positions[i], rest);
+            routes[i].resize(fleet.position(i) + 1);
+            for (int r = 1; r < (int)rest.size(); ++r) routes[i].push_back(rest[r]);
+            stranded[i] = rest.empty();
+        }
+    });
+    for (int k = 0; k < batch; ++k) {
+        int i = rerouted[k];
+        fleet.reroute(i, routes[i], graph);
+        fleet.setStranded(i, stranded[i]);
+        if (stranded[i]) {
+            cout << vehicles[i].getId() << " has no route to its destination and stops at "
+                 << graph.getId(routes[i].back()) << ".\n";
+        } else {
+            cout << vehicles[i].getId() << " rerouted:";
+            for (int r = fleet.position(i); r < (int)routes[i].size(); ++r) cout << " " << graph.getId(routes[i][r]);
+            cout << "\n";
+        }
+    }
+
+    delete[] positions;
+    delete[] rerouted;
+    delete[] affected;
+    delete[] stranded;
 }
-void realTimeMovement(Vehicle* vehicles, int vehicleCount, const string* paths, Graph& graph) {
+
+// With a pool, every tick and status report is split into fixed vehicle chunks that the workers
+// pull off a shared counter. Per-chunk results are combined in chunk order, so the output is
+// identical to the serial run. Given road updates, vehicles follow shortest-path trees towards
+// their destinations that are repaired as the updates arrive, see applyRoadUpdates, and routes
+// is not used (it may be null); the roads get their travel times back at the end, so every call
+// starts from the same network. With a road capacity or a capacity file, travel times grow with
+// the load on each road (RoadCongestion); roads missing from the file get roadCapacity, 0 leaving
+// them unlimited.
+void realTimeMovement(Vehicle* vehicles, int vehicleCount, const Route* routes, Graph& graph, WorkerPool* pool = nullptr,
+                      const RoadUpdate* updates = nullptr, int updateCount = 0, int roadCapacity = 0,
+                      const char* capacityFile = nullptr) {
+    // Live updates need routes the trees agree with and a pool to repair them on
+    WorkerPool* updatePool = nullptr;
+    DestinationTrees* trees = nullptr;
+    Route* liveRoutes = nullptr;
+    int* originalTimes = nullptr; // Of the road each update changes, -1 if there is none
+    if (updateCount > 0) {
+        updatePool = pool ? pool : new WorkerPool(1);
+        trees = new DestinationTrees(graph, vehicles, vehicleCount, *updatePool);
+        liveRoutes = new Route[vehicleCount];
+        for (int i = 0; i < vehicleCount; ++i) {
+            trees->route(i, graph.getIndex(vehicles[i].getStart()), liveRoutes[i]);
+            if (liveRoutes[i].empty()) {
+                cout << "No path exists from " << vehicles[i].getStart() << " to " << vehicles[i].getEnd() << "." << endl;
+            }
+        }
+        routes = liveRoutes;
+        originalTimes = new int[updateCount];
+        for (int k = 0; k < updateCount; ++k) {
+            int road = graph.findRoad(graph.getIndex(updates[k].from), graph.getIndex(updates[k].to));
+            originalTimes[k] = (road == -1) ? -1 : graph.getRoadTime(road);
+        }
+    }
+    int nextUpdate = 0;
+
     cout << "\nReal-Time Vehicle Movement:\n";
 
-    int* currentPositions = new int[vehicleCount](); // Track current position in the path for each vehicle
-    int* travelTimes = new int[vehicleCount]();      // Remaining travel time for each vehicle
-    bool* completed = new bool[vehicleCount]();      // Check if a vehicle has finished its journey
+    FleetState fleet(graph, routes, vehicleCount);
+
+    RoadCongestion* congestion = nullptr;
+    if (roadCapacity > 0 || capacityFile) {
+        congestion = new RoadCongestion(graph, roadCapacity, pool ? pool->size() : 1);
+        if (capacityFile) readRoadCapacities(capacityFile, graph, congestion->capacities);
+    }
+
+    // Status of vehicle i; stranded vehicles stopped short of their destination
+    auto report = [&](ostream& out, int i) {
+        if (fleet.stranded[i]) {
+            out << vehicles[i].getId() << " is stuck at " << graph.getId(routes[i].back())
+                << " with no route to its destination.\n";
+        } else {
+            printVehicleStatus(out, vehicles[i], graph, routes[i], fleet.finished[i], fleet.position(i),
+                               fleet.remainingTimes[i]);
+        }
+    };
+
+    int chunkCount = fleet.chunkCount;
+    ostringstream* chunkReports = new ostringstream[chunkCount > 0 ? chunkCount : 1];
 
     int timeElapsed = 0;
     bool allCompleted = false;
 
     while (!allCompleted) {
-        allCompleted = true;
+        if (trees) {
+            int applied = nextUpdate;
+            applyRoadUpdates(vehicles, updates, updateCount, nextUpdate, timeElapsed, graph, *trees, fleet, liveRoutes,
+                             *updatePool);
+            if (congestion && applied < nextUpdate) {
+                for (; applied < nextUpdate; ++applied) {
+                    int road = graph.findRoad(graph.getIndex(updates[applied].from), graph.getIndex(updates[applied].to));
+                    if (road != -1) congestion->touch(road);
+                }
+                congestion->refresh();
+            }
+        }
 
         // Update vehicles every second
-        for (int i = 0; i < vehicleCount; ++i) {
-            if (!completed[i]) {
-                const string& path = paths[i];
-
-                // If vehicle hasn't reached its destination
-                if (currentPositions[i] < path.length() - 1) {
-                    char from = path[currentPositions[i]];
-                    char to = path[currentPositions[i] + 1];
-
-                    // If starting a new segment, fetch travel time from graph
-                    if (travelTimes[i] == 0) {
-                        travelTimes[i] = graph.getTravelTime(from, to);
-                        currentPositions[i]++;
-                    }
+        {
+            PROFILE_SCOPE("tick");
+            allCompleted = !fleet.tick(pool, congestion);
 
-                    // Decrement travel time for the current segment
-                    if (travelTimes[i] > 0) {
-                        travelTimes[i]--;
-                        allCompleted = false; // At least one vehicle is still moving
-                    }
-
-                    // If this is the last segment and travelTime reaches 0, mark as completed
-                    if (currentPositions[i] == path.length() - 1 && travelTimes[i] == 0) {
-                        completed[i] = true;
-                    }
-                }
-            }
+            // Stranded vehicles wait for the updates still to come
+            if (fleet.strandedCount > 0 && nextUpdate < updateCount) allCompleted = false;
         }
 
         // Display output every 5th second
         if (timeElapsed % 5 == 0) {
+            PROFILE_SCOPE("status report");
             cout << "-At " << timeElapsed << "th second\n";
-            for (int i = 0; i < vehicleCount; ++i) {
-                if (!completed[i]) {
-                    const string& path = paths[i];
-                    if (currentPositions[i] < path.length()) {
-                        char from = path[currentPositions[i] - 1]; // Current position
-                        char to = path[currentPositions[i]];       // Next position
-                        cout << vehicles[i].getId() << " is on road " << from << to
-                             << " (remaining time: " << travelTimes[i] << " seconds)\n";
+            if (pool) {
+                pool->run(chunkCount, 1, [&](int begin, int end, int) {
+                    for (int c = begin; c < end; ++c) {
+                        chunkReports[c].str("");
+                        for (int i = fleet.chunkBegin(c); i < fleet.chunkBegin(c + 1); ++i) {
+                            report(chunkReports[c], i);
+                        }
                     }
-                } else {
-                    cout << vehicles[i].getId() << " has reached its destination.\n";
+                });
+                for (int c = 0; c < chunkCount; ++c) {
+                    cout << chunkReports[c].str();
+                }
+            } else {
+                for (int i = 0; i < vehicleCount; ++i) {
+                    report(cout, i);
                 }
             }
         }
@@ -333,39 +4036,292 @@ void realTimeMovement(Vehicle* vehicles, int vehicleCount, const string* paths,
         timeElapsed++;
     }
 
-    delete[] currentPositions;
-    delete[] travelTimes;
-    delete[] completed;
+    delete[] chunkReports;
+    delete congestion;
+    for (int k = 0; k < nextUpdate; ++k) {
+        if (originalTimes[k] != -1) {
+            graph.updateTravelTime(graph.getIndex(updates[k].from), graph.getIndex(updates[k].to), originalTimes[k]);
+        }
+    }
+    delete[] originalTimes;
+    delete trees;
+    delete[] liveRoutes;
+    if (updatePool != pool) delete updatePool;
+}
+
+// Discrete-event version of realTimeMovement with identical output. Every vehicle has one
+// pending event (its next segment start, or its arrival) in a heap keyed by tick, and the clock
+// jumps straight to the next event or status report. pacing scales the wait between them:
+// 0 runs as fast as possible, 1 follows the wall clock like realTimeMovement.
+void eventDrivenMovement(Vehicle* vehicles, int vehicleCount, const Route* routes, Graph& graph, double pacing) {
+    PROFILE_SCOPE("event-driven simulation");
+    cout << "\nReal-Time Vehicle Movement:\n";
+
+    FleetState fleet(graph, routes, vehicleCount);
+    const int* routeStarts = fleet.routeStarts;
+    const int* routeEnds = fleet.routeEnds;
+    const int* routeTimes = fleet.routeTimes;
+
+    int* currentSegments = new int[vehicleCount]; // Segment being driven, as a route index
+    int* segmentStarts = new int[vehicleCount];   // Tick at which that segment was entered
+    MinHeap events(vehicleCount > 0 ? vehicleCount : 1);
+
+    // A segment occupies max(travel time, 1) ticks and a vehicle arrives on the last tick of its
+    // last segment, so the simulation ends one tick after the latest arrival
+    int finalTick = 0;
+    for (int i = 0; i < vehicleCount; ++i) {
+        currentSegments[i] = routeStarts[i];
+        segmentStarts[i] = 0;
+        if (fleet.finished[i]) continue;
+
+        int arrival = -1;
+        for (int s = routeStarts[i]; s < routeEnds[i]; ++s) {
+            arrival += (routeTimes[s] > 0) ? routeTimes[s] : 1;
+        }
+        if (arrival + 1 > finalTick) finalTick = arrival + 1;
+
+        int first = routeStarts[i];
+        bool lastSegment = first + 1 == routeEnds[i];
+        int duration = (routeTimes[first] > 0) ? routeTimes[first] : 1;
+        events.push(i, lastSegment ? duration - 1 : duration);
+    }
+
+    int clock = 0;
+    for (int reportTick = 0; reportTick <= finalTick; reportTick += 5) {
+        // Apply every event up to and including the report tick
+        while (!events.empty() && events.topKey() <= reportTick) {
+            int eventTick = events.topKey();
+            int i = events.pop();
+            if (pacing > 0 && eventTick > clock) {
+                std::this_thread::sleep_for(std::chrono::duration<double>((eventTick - clock) * pacing));
+                clock = eventTick;
+            }
+
+            int segment = currentSegments[i];
+            if (segment + 1 == routeEnds[i]) {
+                fleet.finished[i] = 1;
+                continue;
+            }
+
+            segment++;
+            currentSegments[i] = segment;
+            segmentStarts[i] = eventTick;
+            int duration = (routeTimes[segment] > 0) ? routeTimes[segment] : 1;
+            bool lastSegment = segment + 1 == routeEnds[i];
+            events.push(i, lastSegment ? eventTick + duration - 1 : eventTick + duration);
+        }
+
+        if (pacing > 0 && reportTick > clock) {
+            std::this_thread::sleep_for(std::chrono::duration<double>((reportTick - clock) * pacing));
+            clock = reportTick;
+        }
+
+        // Display output every 5th second
+        cout << "-At " << reportTick << "th second\n";
+        for (int i = 0; i < vehicleCount; ++i) {
+            int remaining = 0;
+            if (!fleet.finished[i]) {
+                remaining = segmentStarts[i] + routeTimes[currentSegments[i]] - 1 - reportTick;
+            }
+            printVehicleStatus(cout, vehicles[i], graph, routes[i], fleet.finished[i], currentSegments[i] - routeStarts[i] + 1,
+                               remaining > 0 ? remaining : 0);
+        }
+    }
+
+    delete[] currentSegments;
+    delete[] segmentStarts;
+}
+
+// Solves the equilibrium of the fleet's trips and prints the loaded roads. Capacities default to
+// roadCapacity (20 if unset) and may be overridden per road by capacityFile.
+void printTrafficAssignment(Graph& roadMap, const Vehicle* vehicles, int vehicleCount, WorkerPool& pool,
+                            int maxIterations, bool successiveAverages, int roadCapacity, const char* capacityFile) {
+    cout << "\nTraffic Assignment:\n";
+    TrafficAssignment assignment(roadMap, vehicles, vehicleCount, roadCapacity > 0 ? roadCapacity : 20, pool);
+    if (capacityFile) readRoadCapacities(capacityFile, roadMap, assignment.capacities);
+    assignment.solve(maxIterations, 1e-4, successiveAverages, &cout);
+    cout << "Equilibrium after " << assignment.iterations << " iterations (relative gap "
+         << assignment.relativeGap << "):\n";
+
+    ios_base::fmtflags format = cout.flags();
+    streamsize precision = cout.precision(2);
+    cout << fixed;
+    for (int from = 0; from < roadMap.getIntersectionCount(); ++from) {
+        for (int r = roadMap.getFirstRoad(from); r < roadMap.getFirstRoad(from + 1); ++r) {
+            if (assignment.flows[r] < 0.005) continue;
+            cout << "Road " << roadMap.getId(from) << roadMap.getIdSeparator() << roadMap.getId(roadMap.getRoadTarget(r))
+                 << ": "
+                 << assignment.flows[r] << " vehicles, " << assignment.times[r] << " seconds\n";
+        }
+    }
+    cout.flags(format);
+    cout.precision(precision);
+}
+
+void routeAndSimulate(Graph& roadMap, Vehicle* vehicles, int vehicleCount, WorkerPool& pool, bool groupByOrigin,
+                      bool eventDriven, double pacing, const RoadUpdate* updates = nullptr, int updateCount = 0,
+                      int roadCapacity = 0, const char* capacityFile = nullptr) {
+    // Generate shortest paths for all vehicles, unless the live simulation takes them from its trees
+    Route* routes = nullptr;
+    if (eventDriven || updateCount == 0) {
+        routes = groupByOrigin ? findShortestPathsByOrigin(roadMap, vehicles, vehicleCount, pool)
+                               : findShortestPaths(roadMap, vehicles, vehicleCount, pool);
+    }
+
+    // Real-time movement simulation
+    if (eventDriven) {
+        if (updateCount > 0) cout << "Road updates are only applied to the tick-by-tick simulation." << endl;
+        if (roadCapacity > 0 || capacityFile) cout << "Congestion is only simulated tick by tick." << endl;
+        eventDrivenMovement(vehicles, vehicleCount, routes, roadMap, pacing);
+    } else {
+        realTimeMovement(vehicles, vehicleCount, routes, roadMap, &pool, updates, updateCount, roadCapacity,
+                         capacityFile);
+    }
+
+    delete[] routes;
+}
+
+// benchmark.cpp includes this file for everything but main
+#ifndef ROAD_NETWORK_NO_MAIN
+const char* profileFile = nullptr; // --profile: counter and timer totals as JSON
+const char* traceFile = nullptr;   // --trace: Chrome trace of every timed span
+
+#ifdef ROAD_NETWORK_PROFILE
+void writeProfileAtExit() {
+    if (profileFile && !Profile::instance().writeJson(profileFile)) {
+        cout << "Failed to write file: " << profileFile << endl;
+    }
+    if (traceFile && !Profile::instance().writeTrace(traceFile)) {
+        cout << "Failed to write file: " << traceFile << endl;
+    }
 }
-int main() {
+#endif
+
+int main(int argc, char* argv[]) {
+    RoutingMode routingMode = BINARY_HEAP;
+    int threads = 0; // One worker per hardware thread
+    bool groupByOrigin = false;
+    int pathCacheCapacity = 0;
+    bool eventDriven = false;
+    double pacing = 0; // Event-driven mode: 0 = as fast as possible, 1 = wall clock
+    const char* binaryNetwork = nullptr; // Binary copy of the road network, see loadRoadNetwork
+    int streamBatch = 0; // Vehicles per batch when streaming the vehicle file, 0 loads it whole
+    const char* coordinateFile = nullptr; // Intersection positions for --astar
+    int landmarkCount = 0; // Landmarks to select for ALT routing
+    const char* updateFile = nullptr; // Road changes to apply during the simulation
+    int roadCapacity = 0;             // Congestion: vehicles per road before it slows down
+    const char* capacityFile = nullptr;
+    int assignmentIterations = 0;     // Solve the traffic equilibrium first, in at most this many iterations
+    bool successiveAverages = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--radix-heap") == 0) routingMode = RADIX_HEAP;
+        else if (strcmp(argv[i], "--binary-heap") == 0) routingMode = BINARY_HEAP;
+        else if (strcmp(argv[i], "--bidirectional") == 0) routingMode = BIDIRECTIONAL;
+        else if (strcmp(argv[i], "--astar") == 0) routingMode = ASTAR;
+        else if (strcmp(argv[i], "--contraction-hierarchy") == 0) routingMode = CONTRACTION_HIERARCHY;
+        else if (strncmp(argv[i], "--threads=", 10) == 0) threads = atoi(argv[i] + 10);
+        else if (strcmp(argv[i], "--group-by-origin") == 0) groupByOrigin = true;
+        else if (strncmp(argv[i], "--path-cache=", 13) == 0) pathCacheCapacity = atoi(argv[i] + 13);
+        else if (strcmp(argv[i], "--event-driven") == 0) eventDriven = true;
+        else if (strncmp(argv[i], "--pacing=", 9) == 0) {
+            eventDriven = true;
+            pacing = atof(argv[i] + 9);
+        } else if (strncmp(argv[i], "--binary-network=", 17) == 0) {
+            binaryNetwork = argv[i] + 17;
+        } else if (strncmp(argv[i], "--stream-vehicles=", 18) == 0) {
+            streamBatch = atoi(argv[i] + 18);
+        } else if (strncmp(argv[i], "--coordinates=", 14) == 0) {
+            coordinateFile = argv[i] + 14;
+        } else if (strncmp(argv[i], "--landmarks=", 12) == 0) {
+            routingMode = ALT;
+            landmarkCount = atoi(argv[i] + 12);
+        } else if (strncmp(argv[i], "--road-updates=", 15) == 0) {
+            updateFile = argv[i] + 15;
+        } else if (strcmp(argv[i], "--congestion") == 0) {
+            roadCapacity = 20;
+        } else if (strncmp(argv[i], "--congestion=", 13) == 0) {
+            roadCapacity = atoi(argv[i] + 13);
+        } else if (strncmp(argv[i], "--capacities=", 13) == 0) {
+            capacityFile = argv[i] + 13;
+        } else if (strcmp(argv[i], "--assign") == 0) {
+            assignmentIterations = 100;
+        } else if (strncmp(argv[i], "--assign=", 9) == 0) {
+            assignmentIterations = atoi(argv[i] + 9);
+        } else if (strcmp(argv[i], "--msa") == 0) {
+            successiveAverages = true;
+        } else if (strncmp(argv[i], "--profile=", 10) == 0) {
+            profileFile = argv[i] + 10;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            traceFile = argv[i] + 8;
+        }
+    }
+
+    if (profileFile || traceFile) {
+#ifdef ROAD_NETWORK_PROFILE
+        atexit(writeProfileAtExit);
+#else
+        cout << "Profiling is not compiled in; rebuild with -DROAD_NETWORK_PROFILE." << endl;
+#endif
+    }
+
+    WorkerPool pool(threads);
+
     Graph roadMap;
+    roadMap.setRoutingMode(routingMode);
+    roadMap.setPathCacheCapacity(pathCacheCapacity);
     const char* roadFile = "C:\\Users\\HP\\Documents\\DS_PROJECT\\road_network.csv";
-    readCSVAndBuildGraph(roadFile, roadMap);
+    loadRoadNetwork(roadFile, binaryNetwork, roadMap, &pool);
+    if (coordinateFile) roadMap.loadCoordinates(coordinateFile);
+    if (routingMode == CONTRACTION_HIERARCHY) roadMap.buildContractionHierarchy();
+    if (routingMode == ALT) roadMap.selectLandmarks(landmarkCount, pool);
+
+    int updateCount = 0;
+    RoadUpdate* updates = updateFile ? readRoadUpdates(updateFile, updateCount) : nullptr;
 
     cout << "Road Map:" << endl;
     roadMap.displayGraph();
 
-    int vehicleCount = 0;
     const char* vehicleFile = "C:\\Users\\HP\\Documents\\DS_PROJECT\\vehicles.csv";
+
+    if (streamBatch > 0) {
+        if (assignmentIterations > 0) cout << "Traffic assignment needs the whole fleet; skipped when streaming." << endl;
+
+        // Route and simulate each batch while the reader parses the next ones
+        VehicleStream stream(streamBatch);
+        if (stream.open(vehicleFile)) {
+            Vehicle* batch;
+            int batchCount;
+            while ((batchCount = stream.nextBatch(batch)) > 0) {
+                cout << "\nVehicles List:" << endl;
+                printVehicles(batch, batchCount);
+                routeAndSimulate(roadMap, batch, batchCount, pool, groupByOrigin, eventDriven, pacing, updates,
+                                 updateCount, roadCapacity, capacityFile);
+            }
+        }
+        delete[] updates;
+        return 0;
+    }
+
+    int vehicleCount = 0;
     Vehicle* vehicles = readVehicles(vehicleFile, vehicleCount);
 
     if (vehicles) {
         cout << "\nVehicles List:" << endl;
         printVehicles(vehicles, vehicleCount);
 
-        // Generate shortest paths for all vehicles
-        string* paths = new string[vehicleCount];
-        for (int i = 0; i < vehicleCount; ++i) {
-            paths[i] = roadMap.findShortestPath(vehicles[i].getStart(), vehicles[i].getEnd());
+        if (assignmentIterations > 0) {
+            printTrafficAssignment(roadMap, vehicles, vehicleCount, pool, assignmentIterations, successiveAverages,
+                                   roadCapacity, capacityFile);
         }
 
-        // Real-time movement simulation
-        realTimeMovement(vehicles, vehicleCount, paths, roadMap);
+        routeAndSimulate(roadMap, vehicles, vehicleCount, pool, groupByOrigin, eventDriven, pacing, updates,
+                         updateCount, roadCapacity, capacityFile);
 
         // Cleanup
-        delete[] paths;
         delete[] vehicles;
     }
+    delete[] updates;
 
     return 0;
 }
+#endif